@@ -0,0 +1,137 @@
+#include <experimental/filesystem>
+#include <algorithm>  // std::max
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdint>    // std::uint64_t
+#include <cstdio>     // std::snprintf
+#include <iomanip>    // std::setw
+#include <iostream>   // std::cout
+#include <random>     // std::mt19937_64
+#include <string>     // std::string
+#include <utility>    // std::pair
+#include <vector>     // std::vector
+
+#include "midas.hpp"
+
+namespace fs = std::experimental::filesystem::v1;
+
+namespace app {
+
+using dataset = std::vector<std::pair<std::string, std::string>>;
+
+// Number of progress reports per run
+const std::size_t REPORTS = 10;
+
+// Number of keys written per transaction
+const std::size_t WRITES_PER_TX = 4;
+
+void usage()
+{
+    std::cout << "usage:\n";
+    std::cout << "    allocClasses FILE NUM_KEYS NUM_TXS [MAX_VALUE_SIZE]\n\n";
+    std::cout << "Loads NUM_KEYS pairs into a new pool and runs NUM_TXS transactions\n";
+    std::cout << "that update random keys with values of random size, once with the\n";
+    std::cout << "allocation classes of Midas and once with the default allocator.\n";
+    std::cout << "Reports throughput, allocated memory and the fraction of memory in\n";
+    std::cout << "allocator runs that is not used by any object (fragmentation).\n";
+    std::cout << std::endl;
+}
+
+std::string makeKey(std::size_t i)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "key:%012zu", i);
+    return buf;
+}
+
+double readStat(midas::pop_type& pop, const char* name)
+{
+    std::uint64_t value = 0;
+    pmemobj_ctl_get(pop.handle(), name, &value);
+    return value;
+}
+
+void run(const std::string& file, std::size_t poolSize, std::size_t numKeys,
+        std::size_t numTxs, std::size_t maxValueSize, bool allocClasses)
+{
+    midas::pop_type pop;
+    if (!midas::init(pop, file, poolSize)) {
+        std::cout << "error: could not create file <" << file << ">!\n";
+        return;
+    }
+    {
+        midas::StoreConfig config;
+        config.allocClasses = allocClasses;
+        midas::Store store{pop, config};
+
+        dataset data;
+        data.reserve(numKeys);
+        for (std::size_t i=0; i<numKeys; ++i)
+            data.emplace_back(makeKey(i), std::to_string(i));
+        midas::Store::LoadReport report;
+        store.bulkLoad(data.begin(), data.end(), numKeys, report);
+
+        std::mt19937_64 rng{42};
+        const std::string payload(maxValueSize, 'v');
+        const auto step = std::max<std::size_t>(1, numTxs / REPORTS);
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i=1; i<=numTxs; ++i) {
+            auto tx = store.begin();
+            for (std::size_t w=0; w<WRITES_PER_TX; ++w) {
+                const auto key = makeKey(rng() % numKeys);
+                store.write(tx, key, payload.substr(0, 1 + rng() % maxValueSize));
+            }
+            if (store.commit(tx) == midas::Store::OUT_OF_SPACE) {
+                std::cout << "pool is full after " << i << " transactions\n";
+                break;
+            }
+
+            if (i % step == 0) {
+                const auto stop = std::chrono::steady_clock::now();
+                const auto seconds = std::chrono::duration<double>(stop - start).count();
+                const auto space = store.space();
+                const auto runActive = readStat(pop, "stats.heap.run_active");
+                const auto runAllocated = readStat(pop, "stats.heap.run_allocated");
+                const auto fragmentation = runActive > 0 ? 1 - runAllocated / runActive : 0;
+
+                std::cout << std::left << std::setw(9) << (allocClasses ? "classes" : "default")
+                          << std::setw(12) << i
+                          << std::setw(12) << static_cast<std::size_t>(step / seconds)
+                          << std::setw(16) << space.allocated / (1024.0 * 1024)
+                          << fragmentation << std::endl;
+                start = std::chrono::steady_clock::now();
+            }
+        }
+    }
+    pop.close();
+    fs::remove(file);
+}
+
+} // end namespace app
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        std::cout << "error: too few arguments!\n";
+        app::usage();
+        return EXIT_SUCCESS;
+    }
+
+    const std::string file{argv[1]};
+    const std::size_t numKeys = std::stoull(argv[2]);
+    const std::size_t numTxs = std::stoull(argv[3]);
+    const std::size_t maxValueSize = argc > 4 ? std::stoull(argv[4]) : 64;
+
+    // Every transaction adds a version per write, none are collected
+    const std::size_t poolSize = 64ULL * 1024 * 1024 + numKeys * 512 +
+            numTxs * app::WRITES_PER_TX * (128 + 2 * maxValueSize);
+
+    if (fs::exists(file)) {
+        std::cout << "error: file <" << file << "> exists already!\n";
+        return EXIT_SUCCESS;
+    }
+
+    std::cout << "alloc    txs         txs/s       allocated [MB]  fragmentation\n";
+    app::run(file, poolSize, numKeys, numTxs, maxValueSize, true);
+    app::run(file, poolSize, numKeys, numTxs, maxValueSize, false);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+#include <experimental/filesystem>
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdio>     // std::snprintf
+#include <cstring>    // std::strcmp
+#include <iomanip>    // std::setw
+#include <iostream>   // std::cout
+#include <random>     // std::mt19937_64
+#include <string>     // std::string
+#include <utility>    // std::pair
+#include <vector>     // std::vector
+
+#include "midas.hpp"
+
+namespace fs = std::experimental::filesystem::v1;
+
+namespace app {
+
+using dataset = std::vector<std::pair<std::string, std::string>>;
+
+// Number of operations per transaction
+const std::size_t OPS_PER_TX = 8;
+
+void usage()
+{
+    std::cout << "usage:\n";
+    std::cout << "    backends FILE NUM_KEYS NUM_TXS [READ_PERCENT [PROFILE...]]\n\n";
+    std::cout << "Loads NUM_KEYS pairs and runs NUM_TXS transactions of random reads and\n";
+    std::cout << "writes (READ_PERCENT reads, 50 by default), first on a volatile store in\n";
+    std::cout << "DRAM (baseline), then on a persistent store in a new pool and then on a\n";
+    std::cout << "persistent store with the latencies of each emulated PROFILE (all by\n";
+    std::cout << "default). Reports the throughput of each relative to the baseline.\n\n";
+    std::cout << "profiles:\n";
+    for (const auto& profile : midas::media::ALL) {
+        std::cout << "    " << std::left << std::setw(8) << profile.name
+                  << "read " << profile.readLatency << " ns, flush "
+                  << profile.flushLatency << " ns/line, fence "
+                  << profile.fenceLatency << " ns\n";
+    }
+    std::cout << std::endl;
+}
+
+std::string makeKey(std::size_t i)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "key:%012zu", i);
+    return buf;
+}
+
+/** Returns transactions per second */
+template <class Store>
+double run(Store& store, std::size_t numKeys, std::size_t numTxs,
+        unsigned readPercent)
+{
+    dataset data;
+    data.reserve(numKeys);
+    for (std::size_t i=0; i<numKeys; ++i)
+        data.emplace_back(makeKey(i), std::to_string(i));
+    typename Store::LoadReport report;
+    store.bulkLoad(data.begin(), data.end(), numKeys, report);
+
+    std::mt19937_64 rng{42};
+    std::string value;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i=0; i<numTxs; ++i) {
+        auto tx = store.begin();
+        for (std::size_t op=0; op<OPS_PER_TX; ++op) {
+            const auto key = makeKey(rng() % numKeys);
+            if (rng() % 100 < readPercent)
+                store.read(tx, key, value);
+            else
+                store.write(tx, key, std::to_string(i));
+        }
+        store.commit(tx);
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    return numTxs / std::chrono::duration<double>(stop - start).count();
+}
+
+/** Runs on a new pool in the given file. Returns transactions per second. */
+template <class Store, class Pool>
+double runOnPool(const std::string& file, std::size_t numKeys,
+        std::size_t numTxs, unsigned readPercent)
+{
+    // Every write adds a version, none are collected
+    const std::size_t poolSize = 64ULL * 1024 * 1024 + numKeys * 512 +
+            numTxs * OPS_PER_TX * 128;
+
+    Pool pop;
+    if (!midas::init(pop, file, poolSize)) {
+        std::cout << "error: could not create file <" << file << ">!\n";
+        return 0;
+    }
+    double result = 0;
+    {
+        Store store{pop};
+        result = run(store, numKeys, numTxs, readPercent);
+    }
+    pop.close();
+    fs::remove(file);
+    return result;
+}
+
+void report(const std::string& name, double txsPerSecond, double baseline)
+{
+    std::cout << std::left << std::setw(20) << name
+              << std::setw(12) << static_cast<std::size_t>(txsPerSecond)
+              << txsPerSecond / baseline << std::endl;
+}
+
+} // end namespace app
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        std::cout << "error: too few arguments!\n";
+        app::usage();
+        return EXIT_SUCCESS;
+    }
+
+    const std::string file{argv[1]};
+    const std::size_t numKeys = std::stoull(argv[2]);
+    const std::size_t numTxs = std::stoull(argv[3]);
+    const unsigned readPercent = argc > 4 ? std::stoul(argv[4]) : 50;
+
+    std::vector<midas::MediaProfile> profiles;
+    for (int i=5; i<argc; ++i) {
+        bool found = false;
+        for (const auto& profile : midas::media::ALL) {
+            if (std::strcmp(argv[i], profile.name) == 0) {
+                profiles.push_back(profile);
+                found = true;
+            }
+        }
+        if (!found) {
+            std::cout << "error: unknown profile <" << argv[i] << ">!\n";
+            app::usage();
+            return EXIT_SUCCESS;
+        }
+    }
+    if (profiles.empty())
+        profiles.assign(std::begin(midas::media::ALL), std::end(midas::media::ALL));
+
+    if (fs::exists(file)) {
+        std::cout << "error: file <" << file << "> exists already!\n";
+        return EXIT_SUCCESS;
+    }
+
+    std::cout << "backend             txs/s       relative" << std::endl;
+
+    double baseline = 0;
+    {
+        midas::volatile_pop_type pop;
+        midas::VolatileStore store{pop};
+        baseline = app::run(store, numKeys, numTxs, readPercent);
+    }
+    app::report("volatile", baseline, baseline);
+
+    const auto persistent = app::runOnPool<midas::Store, midas::pop_type>(
+            file, numKeys, numTxs, readPercent);
+    app::report("persistent", persistent, baseline);
+
+    for (const auto& profile : profiles) {
+        midas::MediaEmulator::setProfile(profile);
+        const auto emulated = app::runOnPool<midas::EmulatedStore, midas::emulated_pop_type>(
+                file, numKeys, numTxs, readPercent);
+        app::report(std::string{"emulated/"} + profile.name, emulated, baseline);
+    }
+    midas::MediaEmulator::setProfile(midas::media::DRAM);
+    return EXIT_SUCCESS;
+}
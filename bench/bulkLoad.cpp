@@ -0,0 +1,119 @@
+#include <experimental/filesystem>
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdio>     // std::snprintf
+#include <iostream>   // std::cout
+#include <string>     // std::string
+#include <utility>    // std::pair
+#include <vector>     // std::vector
+
+#include "midas.hpp"
+
+namespace fs = std::experimental::filesystem::v1;
+
+namespace app {
+
+using dataset = std::vector<std::pair<std::string, std::string>>;
+
+void usage()
+{
+    std::cout << "usage:\n";
+    std::cout << "    bulkLoad FILE MODE NUM_KEYS [VALUE_SIZE] [POOL_MB]\n\n";
+    std::cout << "Loads NUM_KEYS pairs into a new pool and reports throughput.\n\n";
+    std::cout << "MODE:\n";
+    std::cout << "    bulk\n";
+    std::cout << "        Uses Store::bulkLoad() with the exact number of keys as size hint.\n";
+    std::cout << "    tx\n";
+    std::cout << "        Uses one write() and commit() per key.\n";
+    std::cout << std::endl;
+}
+
+dataset generate(std::size_t numKeys, std::size_t valueSize)
+{
+    dataset data;
+    data.reserve(numKeys);
+    char buf[32];
+    for (std::size_t i=0; i<numKeys; ++i) {
+        std::snprintf(buf, sizeof(buf), "key:%012zu", i);
+        data.emplace_back(buf, std::string(valueSize, 'a' + i % 26));
+    }
+    return data;
+}
+
+void loadBulk(midas::Store& store, const dataset& data)
+{
+    midas::Store::LoadReport report;
+    const auto status = store.bulkLoad(data.begin(), data.end(), data.size(),
+            report);
+    if (status) {
+        std::cout << "bulk load failed with status: " << status << std::endl;
+        return;
+    }
+    std::cout << "keys:   " << report.keys << '\n';
+    std::cout << "time:   " << report.seconds << " s\n";
+    std::cout << "keys/s: " << report.keysPerSecond() << std::endl;
+}
+
+void loadTransactional(midas::Store& store, const dataset& data)
+{
+    std::size_t loaded = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& [key, value] : data) {
+        auto tx = store.begin();
+        if (store.write(tx, key, value) == midas::Store::OK &&
+                store.commit(tx) == midas::Store::OK)
+            ++loaded;
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    const auto seconds = std::chrono::duration<double>(stop - start).count();
+    std::cout << "keys:   " << loaded << '\n';
+    std::cout << "time:   " << seconds << " s\n";
+    std::cout << "keys/s: " << (seconds > 0 ? loaded / seconds : 0) << std::endl;
+}
+
+} // end namespace app
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        std::cout << "error: too few arguments!\n";
+        app::usage();
+        return EXIT_SUCCESS;
+    }
+
+    const std::string file{argv[1]};
+    const std::string mode{argv[2]};
+    const std::size_t numKeys = std::stoull(argv[3]);
+    const std::size_t valueSize = argc > 4 ? std::stoull(argv[4]) : 16;
+    const std::size_t poolSize = (argc > 5 ? std::stoull(argv[5]) : 1024)
+        * 1024 * 1024;
+
+    if (mode != "bulk" && mode != "tx") {
+        std::cout << "error: unknown mode <" << mode << ">!\n";
+        app::usage();
+        return EXIT_SUCCESS;
+    }
+
+    // Loading into an existing pool would distort the results
+    if (fs::exists(file)) {
+        std::cout << "error: file <" << file << "> exists already!\n";
+        return EXIT_SUCCESS;
+    }
+
+    const auto data = app::generate(numKeys, valueSize);
+
+    midas::pop_type pop;
+    if (midas::init(pop, file, poolSize)) {
+        {
+            midas::Store store{pop};
+            if (mode == "bulk")
+                app::loadBulk(store, data);
+            else
+                app::loadTransactional(store, data);
+        }
+        pop.close();
+    }
+    else {
+        std::cout << "error: could not open file <" << file << ">!\n";
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+#include <algorithm>  // std::max
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdint>    // std::uint64_t
+#include <cstdio>     // std::snprintf
+#include <iomanip>    // std::setw
+#include <iostream>   // std::cout
+#include <random>     // std::mt19937_64
+#include <string>     // std::string
+#include <vector>     // std::vector
+
+#include "hash.hpp"
+#include "types.hpp"
+
+namespace app {
+
+using midas::detail::size_type;
+using midas::detail::PolynomialHash;
+using midas::detail::StrideHash;
+
+// Mirrors IndexParams, so bucket counts match those of a real index
+const size_type INIT_SIZE = 4;
+const size_type GROW_FACTOR = 2;
+const double MAX_LOAD_FACTOR = 0.75;
+
+using keyset = std::vector<std::string>;
+
+// Keeps the compiler from dropping the timed hash loops
+volatile std::uint64_t sink;
+
+void usage()
+{
+    std::cout << "usage:\n";
+    std::cout << "    hashDistribution [NUM_KEYS]\n\n";
+    std::cout << "Hashes several realistic key sets into a table that is sized like\n";
+    std::cout << "the index and reports bucket-length statistics per hash policy.\n";
+    std::cout << std::endl;
+}
+
+// ############################################################################
+// Key sets
+// ############################################################################
+
+keyset sequentialIds(size_type n)
+{
+    keyset keys;
+    keys.reserve(n);
+    for (size_type i=0; i<n; ++i)
+        keys.push_back(std::to_string(i));
+    return keys;
+}
+
+keyset paddedIds(size_type n)
+{
+    keyset keys;
+    keys.reserve(n);
+    char buf[32];
+    for (size_type i=0; i<n; ++i) {
+        std::snprintf(buf, sizeof(buf), "user:%012zu", i);
+        keys.emplace_back(buf);
+    }
+    return keys;
+}
+
+keyset uuids(size_type n)
+{
+    keyset keys;
+    keys.reserve(n);
+    std::mt19937_64 rng{42};
+    char buf[40];
+    for (size_type i=0; i<n; ++i) {
+        const auto hi = rng();
+        const auto lo = rng();
+        std::snprintf(buf, sizeof(buf), "%08x-%04x-4%03x-%04x-%012llx",
+                unsigned(hi >> 32), unsigned(hi >> 16) & 0xffff,
+                unsigned(hi) & 0xfff, unsigned(0x8000 | ((lo >> 48) & 0x3fff)),
+                static_cast<unsigned long long>(lo & 0xffffffffffffULL));
+        keys.emplace_back(buf);
+    }
+    return keys;
+}
+
+keyset compositeKeys(size_type n)
+{
+    keyset keys;
+    keys.reserve(n);
+    char buf[48];
+    for (size_type i=0; i<n; ++i) {
+        std::snprintf(buf, sizeof(buf), "tenant:%04zu:order:%04zu:line:%02zu",
+                i / 10000, (i / 10) % 1000, i % 10);
+        keys.emplace_back(buf);
+    }
+    return keys;
+}
+
+keyset urls(size_type n)
+{
+    keyset keys;
+    keys.reserve(n);
+    for (size_type i=0; i<n; ++i)
+        keys.push_back("https://shop.example.com/catalog/item/" +
+                std::to_string(i) + "/details");
+    return keys;
+}
+
+// ############################################################################
+// Measurements
+// ############################################################################
+
+/** Replays the growth policy of the index for n insertions */
+size_type bucketCount(size_type n)
+{
+    size_type buckets = INIT_SIZE;
+    while (static_cast<double>(n) / buckets > MAX_LOAD_FACTOR)
+        buckets *= GROW_FACTOR;
+    return buckets;
+}
+
+template <class KeyHash>
+void measure(const std::string& name, const keyset& keys)
+{
+    const auto numBuckets = bucketCount(keys.size());
+    std::vector<size_type> lengths(numBuckets);
+
+    for (const auto& key : keys)
+        ++lengths[KeyHash::hash(key.data(), key.size()) % numBuckets];
+
+    // Time the hash function alone (without the scattered bucket updates)
+    std::uint64_t sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& key : keys)
+        sum ^= KeyHash::hash(key.data(), key.size());
+    const auto stop = std::chrono::steady_clock::now();
+    sink = sum;
+
+    size_type empty = 0;
+    size_type longest = 0;
+    double probes = 0;
+    for (const auto len : lengths) {
+        if (len == 0)
+            ++empty;
+        longest = std::max(longest, len);
+
+        // Key comparisons needed to find each key of this bucket once
+        probes += len * (len + 1) / 2.0;
+    }
+
+    const auto numKeys = static_cast<double>(keys.size());
+    const auto load = numKeys / numBuckets;
+    const auto ns = std::chrono::duration<double, std::nano>(stop - start).count();
+
+    // A uniform hash needs (1 + load / 2) comparisons per successful lookup
+    std::cout << "  " << std::left << std::setw(12) << name << std::right
+              << std::fixed << std::setprecision(2)
+              << std::setw(10) << numBuckets
+              << std::setw(9) << (100.0 * empty / numBuckets) << '%'
+              << std::setw(9) << longest
+              << std::setw(10) << (probes / numKeys)
+              << std::setw(10) << (1 + load / 2)
+              << std::setw(10) << (ns / numKeys) << '\n';
+}
+
+void run(const std::string& name, const keyset& keys)
+{
+    std::cout << name << " (" << keys.size() << " keys, e.g. \""
+              << keys.back() << "\")\n";
+    std::cout << "  " << std::left << std::setw(12) << "hash" << std::right
+              << std::setw(10) << "buckets"
+              << std::setw(10) << "empty"
+              << std::setw(9) << "longest"
+              << std::setw(10) << "probes"
+              << std::setw(10) << "ideal"
+              << std::setw(10) << "ns/key" << '\n';
+    measure<PolynomialHash>("polynomial", keys);
+    measure<StrideHash<>>("stride", keys);
+    std::cout << std::endl;
+}
+
+} // end namespace app
+
+int main(int argc, char* argv[])
+{
+    app::size_type numKeys = 1000000;
+    if (argc > 1) {
+        const std::string arg{argv[1]};
+        if (arg == "-h" || arg == "help") {
+            app::usage();
+            return EXIT_SUCCESS;
+        }
+        numKeys = std::stoull(arg);
+    }
+
+    app::run("sequential ids", app::sequentialIds(numKeys));
+    app::run("padded ids", app::paddedIds(numKeys));
+    app::run("composite keys", app::compositeKeys(numKeys));
+    app::run("uuids", app::uuids(numKeys));
+    app::run("urls", app::urls(numKeys));
+    return EXIT_SUCCESS;
+}
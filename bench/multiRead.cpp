@@ -0,0 +1,133 @@
+#include <experimental/filesystem>
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdio>     // std::snprintf
+#include <iomanip>    // std::setw
+#include <iostream>   // std::cout
+#include <random>     // std::mt19937_64
+#include <string>     // std::string
+#include <utility>    // std::pair
+#include <vector>     // std::vector
+
+#include "midas.hpp"
+
+namespace fs = std::experimental::filesystem::v1;
+
+namespace app {
+
+using dataset = std::vector<std::pair<std::string, std::string>>;
+using keyset = std::vector<std::string>;
+
+void usage()
+{
+    std::cout << "usage:\n";
+    std::cout << "    multiRead FILE NUM_KEYS ROUNDS BATCH_SIZE...\n\n";
+    std::cout << "Loads NUM_KEYS pairs into a new pool. Then, for each BATCH_SIZE, reads\n";
+    std::cout << "ROUNDS batches of random keys, once with one read() per key and once\n";
+    std::cout << "with one multiRead() per batch, and reports the time per key.\n";
+    std::cout << std::endl;
+}
+
+std::string makeKey(std::size_t i)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "key:%012zu", i);
+    return buf;
+}
+
+std::vector<keyset> makeBatches(std::size_t numKeys, std::size_t rounds,
+        std::size_t batchSize)
+{
+    std::mt19937_64 rng{42};
+    std::vector<keyset> batches(rounds);
+    for (auto& batch : batches)
+        for (std::size_t i=0; i<batchSize; ++i)
+            batch.push_back(makeKey(rng() % numKeys));
+    return batches;
+}
+
+/** Returns nanoseconds per key */
+double readSingle(midas::Store& store, const std::vector<keyset>& batches)
+{
+    std::size_t keys = 0;
+    std::string value;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& batch : batches) {
+        auto tx = store.begin();
+        for (const auto& key : batch)
+            store.read(tx, key, value);
+        store.commit(tx);
+        keys += batch.size();
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / keys;
+}
+
+/** Returns nanoseconds per key */
+double readBatched(midas::Store& store, const std::vector<keyset>& batches)
+{
+    std::size_t keys = 0;
+    std::vector<std::string> values;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& batch : batches) {
+        auto tx = store.begin();
+        store.multiRead(tx, batch, values);
+        store.commit(tx);
+        keys += batch.size();
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / keys;
+}
+
+} // end namespace app
+
+int main(int argc, char* argv[])
+{
+    if (argc < 5) {
+        std::cout << "error: too few arguments!\n";
+        app::usage();
+        return EXIT_SUCCESS;
+    }
+
+    const std::string file{argv[1]};
+    const std::size_t numKeys = std::stoull(argv[2]);
+    const std::size_t rounds = std::stoull(argv[3]);
+    const std::size_t poolSize = 64ULL * 1024 * 1024 + numKeys * 512;
+
+    if (fs::exists(file)) {
+        std::cout << "error: file <" << file << "> exists already!\n";
+        return EXIT_SUCCESS;
+    }
+
+    midas::pop_type pop;
+    if (!midas::init(pop, file, poolSize)) {
+        std::cout << "error: could not create file <" << file << ">!\n";
+        return EXIT_SUCCESS;
+    }
+    {
+        midas::Store store{pop};
+
+        app::dataset data;
+        data.reserve(numKeys);
+        for (std::size_t i=0; i<numKeys; ++i)
+            data.emplace_back(app::makeKey(i), std::to_string(i));
+        midas::Store::LoadReport report;
+        store.bulkLoad(data.begin(), data.end(), numKeys, report);
+
+        std::cout << "batch    read [ns/key]  multiRead [ns/key]\n";
+        for (int i=4; i<argc; ++i) {
+            const std::size_t batchSize = std::stoull(argv[i]);
+            const auto batches = app::makeBatches(numKeys, rounds, batchSize);
+
+            // Warm up the inline copies of all histories that are read
+            app::readSingle(store, batches);
+
+            const auto single = app::readSingle(store, batches);
+            const auto batched = app::readBatched(store, batches);
+            std::cout << std::left << std::setw(9) << batchSize
+                      << std::setw(15) << single << batched << std::endl;
+        }
+    }
+    pop.close();
+    fs::remove(file);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+#include <experimental/filesystem>
+#include <algorithm>  // std::max
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdio>     // std::snprintf
+#include <iomanip>    // std::setw
+#include <iostream>   // std::cout
+#include <string>     // std::string
+#include <utility>    // std::pair
+#include <vector>     // std::vector
+
+#include "midas.hpp"
+
+namespace fs = std::experimental::filesystem::v1;
+
+namespace app {
+
+using dataset = std::vector<std::pair<std::string, std::string>>;
+using seconds = std::chrono::duration<double>;
+
+void usage()
+{
+    std::cout << "usage:\n";
+    std::cout << "    recovery FILE NUM_KEYS HISTORY_LENGTH RUN...\n\n";
+    std::cout << "Creates a pool with NUM_KEYS keys, each with HISTORY_LENGTH committed\n";
+    std::cout << "versions. Then, for each RUN, opens a copy of that pool and measures how\n";
+    std::cout << "long it takes to construct a store (recovery) and to read one key.\n\n";
+    std::cout << "RUN:\n";
+    std::cout << "    THREADS\n";
+    std::cout << "        Eager recovery with the given number of threads.\n";
+    std::cout << "    lazy\n";
+    std::cout << "        Lazy recovery (without background recovery).\n";
+    std::cout << std::endl;
+}
+
+std::string makeKey(std::size_t i)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "key:%012zu", i);
+    return buf;
+}
+
+void populate(midas::pop_type& pop, std::size_t numKeys, std::size_t historyLength)
+{
+    midas::Store store{pop};
+
+    // First version of each key
+    dataset data;
+    data.reserve(numKeys);
+    for (std::size_t i=0; i<numKeys; ++i)
+        data.emplace_back(makeKey(i), "0");
+    midas::Store::LoadReport report;
+    store.bulkLoad(data.begin(), data.end(), numKeys, report);
+
+    // Each update appends another version to a history
+    for (std::size_t h=1; h<historyLength; ++h) {
+        const auto value = std::to_string(h);
+        for (std::size_t i=0; i<numKeys; ++i) {
+            auto tx = store.begin();
+            store.write(tx, makeKey(i), value);
+            store.commit(tx);
+        }
+    }
+}
+
+} // end namespace app
+
+int main(int argc, char* argv[])
+{
+    if (argc < 5) {
+        std::cout << "error: too few arguments!\n";
+        app::usage();
+        return EXIT_SUCCESS;
+    }
+
+    const std::string file{argv[1]};
+    const std::string copy{file + ".recovery"};
+    const std::size_t numKeys = std::stoull(argv[2]);
+    const std::size_t historyLength = std::max(1ULL, std::stoull(argv[3]));
+
+    // Generous estimate of the space needed per version
+    const std::size_t poolSize = 64ULL * 1024 * 1024 +
+        numKeys * historyLength * 512;
+
+    if (fs::exists(file) || fs::exists(copy)) {
+        std::cout << "error: file <" << file << "> or <" << copy
+                  << "> exists already!\n";
+        return EXIT_SUCCESS;
+    }
+
+    std::cout << "populating " << numKeys << " keys with " << historyLength
+              << " versions each..." << std::endl;
+    {
+        midas::pop_type pop;
+        if (!midas::init(pop, file, poolSize)) {
+            std::cout << "error: could not create file <" << file << ">!\n";
+            return EXIT_SUCCESS;
+        }
+        app::populate(pop, numKeys, historyLength);
+        pop.close();
+    }
+
+    std::cout << "run      open [s]  recovery [s]  first read [s]\n";
+    for (int i=4; i<argc; ++i) {
+        const std::string run{argv[i]};
+        midas::StoreConfig config;
+        if (run == "lazy")
+            config.recovery = midas::StoreConfig::Recovery::Lazy;
+        else
+            config.recoveryThreads = std::stoull(run);
+
+        // Recovery collapses histories, so each run gets a fresh copy
+        fs::copy_file(file, copy);
+
+        midas::pop_type pop;
+        const auto start = std::chrono::steady_clock::now();
+        midas::init(pop, copy, poolSize);
+        const auto opened = std::chrono::steady_clock::now();
+        {
+            midas::Store store{pop, config};
+            const auto recovered = std::chrono::steady_clock::now();
+
+            auto tx = store.begin();
+            std::string value;
+            store.read(tx, app::makeKey(numKeys / 2), value);
+            store.commit(tx);
+            const auto firstRead = std::chrono::steady_clock::now();
+
+            std::cout << std::left << std::setw(9) << run
+                      << app::seconds(opened - start).count() << "  "
+                      << app::seconds(recovered - opened).count() << "  "
+                      << app::seconds(firstRead - recovered).count() << std::endl;
+        }
+        pop.close();
+        fs::remove(copy);
+    }
+    fs::remove(file);
+    return EXIT_SUCCESS;
+}
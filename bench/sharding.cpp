@@ -0,0 +1,157 @@
+#include <experimental/filesystem>
+#include <atomic>     // std::atomic
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdio>     // std::snprintf
+#include <iomanip>    // std::setw
+#include <iostream>   // std::cout
+#include <memory>     // std::unique_ptr
+#include <random>     // std::mt19937_64
+#include <string>     // std::string
+#include <thread>     // std::thread
+#include <utility>    // std::pair
+#include <vector>     // std::vector
+
+#include "midas.hpp"
+
+namespace fs = std::experimental::filesystem::v1;
+
+namespace app {
+
+using dataset = std::vector<std::pair<std::string, std::string>>;
+
+// Number of keys written per transaction
+const std::size_t OPS_PER_TX = 4;
+
+struct Result {
+    double txsPerSecond;
+    std::size_t aborts;
+};
+
+void usage()
+{
+    std::cout << "usage:\n";
+    std::cout << "    sharding DIR NUM_KEYS NUM_TXS [THREADS] [MAX_SHARDS] [CROSS_PERCENT]\n\n";
+    std::cout << "Spreads NUM_KEYS pairs over 1, 2, 4, ... up to MAX_SHARDS shards (8 by\n";
+    std::cout << "default) in new pools in DIR and runs NUM_TXS write transactions of " << OPS_PER_TX << "\n";
+    std::cout << "keys each on THREADS threads (4 by default). CROSS_PERCENT of them (0 by\n";
+    std::cout << "default) write keys of random shards, the others keys of a single shard.\n";
+    std::cout << "Reports the throughput of each shard count relative to one shard.\n";
+    std::cout << std::endl;
+}
+
+std::string makeKey(std::size_t i)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "key:%012zu", i);
+    return buf;
+}
+
+Result run(const std::string& dir, std::size_t shards, std::size_t numKeys,
+        std::size_t numTxs, std::size_t threads, unsigned crossPercent)
+{
+    // Every write adds a version, none are collected
+    const std::size_t poolSize = 64ULL * 1024 * 1024 +
+            (numKeys * 512 + numTxs * OPS_PER_TX * 128) / shards;
+
+    std::vector<midas::pop_type> pools(shards);
+    std::vector<midas::pop_type*> pointers;
+    for (std::size_t i=0; i<shards; ++i) {
+        const auto file = dir + "/shard-" + std::to_string(i) + ".pool";
+        if (!midas::init(pools[i], file, poolSize)) {
+            std::cout << "error: could not create file <" << file << ">!\n";
+            return Result{0, 0};
+        }
+        pointers.push_back(&pools[i]);
+    }
+
+    Result result{0, 0};
+    {
+        midas::ShardedStore store{pointers};
+
+        // Each shard is loaded on its own, and transactions that stay in a
+        // shard pick their keys from the shard's keys
+        std::vector<dataset> data(shards);
+        for (std::size_t i=0; i<numKeys; ++i) {
+            auto key = makeKey(i);
+            data[store.shardOf(key)].emplace_back(std::move(key), std::to_string(i));
+        }
+        for (std::size_t i=0; i<shards; ++i) {
+            midas::Store::LoadReport report;
+            store.shard(i).bulkLoad(data[i].begin(), data[i].end(), data[i].size(), report);
+        }
+
+        std::atomic<std::size_t> aborts{0};
+        std::vector<std::thread> workers;
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t t=0; t<threads; ++t) {
+            workers.emplace_back([&,t](){
+                std::mt19937_64 rng{42 + t};
+                const auto value = std::to_string(t);
+                for (std::size_t i=t; i<numTxs; i+=threads) {
+                    const bool cross = rng() % 100 < crossPercent;
+                    const auto& keys = data[rng() % shards];
+                    auto tx = store.begin();
+                    for (std::size_t op=0; op<OPS_PER_TX; ++op) {
+                        const auto& key = cross
+                                ? makeKey(rng() % numKeys)
+                                : keys[rng() % keys.size()].first;
+                        if (store.upsert(tx, key, value))
+                            break;
+                    }
+                    if (store.commit(tx))
+                        ++aborts;
+                }
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+        const auto stop = std::chrono::steady_clock::now();
+
+        result.aborts = aborts;
+        result.txsPerSecond = (numTxs - aborts) /
+                std::chrono::duration<double>(stop - start).count();
+    }
+    for (std::size_t i=0; i<shards; ++i) {
+        pools[i].close();
+        fs::remove(dir + "/shard-" + std::to_string(i) + ".pool");
+    }
+    return result;
+}
+
+} // end namespace app
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        std::cout << "error: too few arguments!\n";
+        app::usage();
+        return EXIT_SUCCESS;
+    }
+
+    const std::string dir{argv[1]};
+    const std::size_t numKeys = std::stoull(argv[2]);
+    const std::size_t numTxs = std::stoull(argv[3]);
+    const std::size_t threads = argc > 4 ? std::stoull(argv[4]) : 4;
+    const std::size_t maxShards = argc > 5 ? std::stoull(argv[5]) : 8;
+    const unsigned crossPercent = argc > 6 ? std::stoul(argv[6]) : 0;
+
+    if (fs::exists(dir)) {
+        std::cout << "error: <" << dir << "> exists already!\n";
+        return EXIT_SUCCESS;
+    }
+    fs::create_directories(dir);
+
+    std::cout << "shards    txs/s       aborts      relative" << std::endl;
+    double baseline = 0;
+    for (std::size_t shards=1; shards<=maxShards; shards*=2) {
+        const auto result = app::run(dir, shards, numKeys, numTxs, threads, crossPercent);
+        if (shards == 1)
+            baseline = result.txsPerSecond;
+        std::cout << std::left << std::setw(10) << shards
+                  << std::setw(12) << static_cast<std::size_t>(result.txsPerSecond)
+                  << std::setw(12) << result.aborts
+                  << (baseline > 0 ? result.txsPerSecond / baseline : 0) << std::endl;
+    }
+    fs::remove(dir);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include <experimental/filesystem>
+#include <cstdio>     // std::snprintf
+#include <iostream>   // std::cout
+#include <string>     // std::string
+#include <utility>    // std::pair
+#include <vector>     // std::vector
+
+#include "midas.hpp"
+
+namespace fs = std::experimental::filesystem::v1;
+
+namespace app {
+
+using dataset = std::vector<std::pair<std::string, std::string>>;
+
+void usage()
+{
+    std::cout << "usage:\n";
+    std::cout << "    snapshot FILE DIR NUM_KEYS [VALUE_SIZE] [THREADS] [POOL_MB]\n\n";
+    std::cout << "Loads NUM_KEYS pairs into a new pool in FILE, exports a snapshot of it\n";
+    std::cout << "to DIR with THREADS shards (4 by default) and imports the snapshot into\n";
+    std::cout << "a second new pool next to FILE. Reports the throughput of both.\n";
+    std::cout << std::endl;
+}
+
+dataset generate(std::size_t numKeys, std::size_t valueSize)
+{
+    dataset data;
+    data.reserve(numKeys);
+    char buf[32];
+    for (std::size_t i=0; i<numKeys; ++i) {
+        std::snprintf(buf, sizeof(buf), "key:%012zu", i);
+        data.emplace_back(buf, std::string(valueSize, 'a' + i % 26));
+    }
+    return data;
+}
+
+void report(const std::string& name, const midas::Store::SnapshotReport& report)
+{
+    std::cout << name << '\n';
+    std::cout << "  keys:   " << report.keys << '\n';
+    std::cout << "  bytes:  " << report.bytes << '\n';
+    std::cout << "  time:   " << report.seconds << " s\n";
+    std::cout << "  MB/s:   " << report.bytesPerSecond() / (1024 * 1024) << std::endl;
+}
+
+} // end namespace app
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        std::cout << "error: too few arguments!\n";
+        app::usage();
+        return EXIT_SUCCESS;
+    }
+
+    const std::string file{argv[1]};
+    const std::string dir{argv[2]};
+    const std::size_t numKeys = std::stoull(argv[3]);
+    const std::size_t valueSize = argc > 4 ? std::stoull(argv[4]) : 100;
+    const std::size_t threads = argc > 5 ? std::stoull(argv[5]) : 4;
+    const std::size_t poolSize = (argc > 6 ? std::stoull(argv[6]) : 1024)
+        * 1024 * 1024;
+    const std::string restored = file + ".restored";
+
+    if (fs::exists(file) || fs::exists(restored) || fs::exists(dir)) {
+        std::cout << "error: <" << file << ">, <" << restored << "> or <"
+                  << dir << "> exists already!\n";
+        return EXIT_SUCCESS;
+    }
+
+    {
+        const auto data = app::generate(numKeys, valueSize);
+        midas::pop_type pop;
+        if (!midas::init(pop, file, poolSize)) {
+            std::cout << "error: could not create file <" << file << ">!\n";
+            return EXIT_SUCCESS;
+        }
+        {
+            midas::Store store{pop};
+            midas::Store::LoadReport load;
+            store.bulkLoad(data.begin(), data.end(), data.size(), load);
+
+            midas::Store::SnapshotReport report;
+            const auto status = store.exportSnapshot(dir, threads, report);
+            if (status)
+                std::cout << "export failed with status: " << status << std::endl;
+            else
+                app::report("export", report);
+        }
+        pop.close();
+    }
+
+    midas::pop_type pop;
+    if (!midas::init(pop, restored, poolSize)) {
+        std::cout << "error: could not create file <" << restored << ">!\n";
+        return EXIT_SUCCESS;
+    }
+    {
+        midas::Store store{pop};
+        midas::Store::SnapshotReport report;
+        const auto status = store.importSnapshot(dir, threads, report);
+        if (status)
+            std::cout << "import failed with status: " << status << std::endl;
+        else
+            app::report("import", report);
+    }
+    pop.close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+#ifndef MIDAS_ALLOC_CLASS_HPP
+#define MIDAS_ALLOC_CLASS_HPP
+
+#include <atomic>  // std::atomic
+#include <cstddef> // std::size_t
+#include <mutex>   // std::mutex, std::lock_guard
+#include <new>     // placement new
+#include <string>  // std::string, std::to_string
+#include <utility> // std::forward
+
+#include <libpmemobj.h>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pexceptions.hpp>
+
+namespace midas {
+namespace detail {
+
+namespace pmdk = pmem::obj;
+
+/**
+ * A PMDK allocation class for objects of exactly Size bytes.
+ *
+ * Objects of a class are packed into runs of their own and carry no
+ * allocation header, so each one takes exactly Size bytes (aligned to
+ * Alignment if non-zero) and they do not fragment the runs shared by
+ * variable-sized payloads. PMDK serves allocations from per-thread arenas,
+ * so there is no need for caches on top of it.
+ *
+ * Allocation classes are not persistent, so they must be registered every
+ * time a pool is opened (see enable()). Their ids are fixed and thus the
+ * same in all pools. Until a class is enabled for a pool, make() falls back
+ * to the default allocator there. Objects of either allocator are freed
+ * with pmdk::delete_persistent() as usual.
+ */
+template <std::size_t Size, unsigned Id, std::size_t Alignment = 0>
+class AllocClass
+{
+// ############################################################################
+// TYPES
+// ############################################################################
+
+public:
+    static constexpr std::size_t SIZE = Size;
+    static constexpr unsigned ID = Id;
+
+    // Number of objects per run. Larger runs mean fewer run headers.
+    static constexpr unsigned UNITS_PER_BLOCK = 1024;
+
+    // Number of pools this class can be enabled for at the same time. Pools
+    // beyond that use the default allocator.
+    static constexpr std::size_t MAX_POOLS = 64;
+
+// ############################################################################
+// MEMBER VARIABLES
+// ############################################################################
+
+private:
+    // Pools for which make() uses this class (null if unused). Lookups do
+    // not lock, changes are serialized by sMutex.
+    static inline std::atomic<PMEMobjpool*> sPools[MAX_POOLS]{};
+    static inline std::mutex sMutex;
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+public:
+    /**
+     * Registers this class with the given pool unless enabled is false.
+     * Returns whether make() uses this class for the pool from now on. If
+     * PMDK rejects the class, the default allocator is used instead.
+     *
+     * Pools are told apart by their handle, which may be reused once a pool
+     * is closed. Hence, the class should be disabled before (enabled set to
+     * false) and must be enabled again whenever a pool is opened.
+     */
+    static bool enable(PMEMobjpool* pop, bool enabled)
+    {
+        if (enabled) {
+            pobj_alloc_class_desc desc{};
+            desc.unit_size = Size;
+            desc.alignment = Alignment;
+            desc.units_per_block = UNITS_PER_BLOCK;
+            desc.header_type = POBJ_HEADER_NONE;
+
+            // The class may have been registered with this pool before
+            const auto name = "heap.alloc_class." + std::to_string(Id) + ".desc";
+            if (pmemobj_ctl_set(pop, name.c_str(), &desc) != 0) {
+                pobj_alloc_class_desc existing{};
+                enabled = pmemobj_ctl_get(pop, name.c_str(), &existing) == 0 &&
+                        existing.unit_size == Size &&
+                        existing.header_type == POBJ_HEADER_NONE;
+            }
+        }
+
+        std::lock_guard<std::mutex> guard{sMutex};
+        for (auto& entry : sPools)
+            if (entry.load() == pop)
+                entry.store(nullptr);
+        if (enabled) {
+            enabled = false;
+            for (auto& entry : sPools) {
+                if (!entry.load()) {
+                    entry.store(pop);
+                    enabled = true;
+                    break;
+                }
+            }
+        }
+        return enabled;
+    }
+
+    static bool enabled(PMEMobjpool* pop)
+    {
+        for (const auto& entry : sPools)
+            if (entry.load(std::memory_order_relaxed) == pop)
+                return true;
+        return false;
+    }
+
+    /**
+     * Creates an object of type T in the current transaction of the given
+     * pool, like pmdk::make_persistent().
+     */
+    template <class T, class... Args>
+    static pmdk::persistent_ptr<T> make(PMEMobjpool* pop, Args&&... args)
+    {
+        static_assert(sizeof(T) == Size, "object does not fit the class");
+
+        if (!enabled(pop))
+            return pmdk::make_persistent<T>(std::forward<Args>(args)...);
+
+        if (pmemobj_tx_stage() != TX_STAGE_WORK)
+            throw pmem::transaction_scope_error(
+                    "refusing to allocate memory outside of transaction scope");
+
+        const auto oid = pmemobj_tx_xalloc(Size, 0, POBJ_CLASS_ID(Id));
+        if (OID_IS_NULL(oid))
+            throw pmem::transaction_alloc_error(
+                    "failed to allocate persistent memory object");
+
+        pmdk::persistent_ptr<T> ptr{oid};
+        new (ptr.get()) T(std::forward<Args>(args)...);
+        return ptr;
+    }
+
+}; // end class AllocClass
+
+// Objects that fill exactly one cache line (histories, index nodes). Ids of
+// Midas classes start at 200, far above the default classes of PMDK.
+using LineAllocClass = AllocClass<64, 201, 64>;
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
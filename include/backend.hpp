@@ -0,0 +1,439 @@
+#ifndef MIDAS_BACKEND_HPP
+#define MIDAS_BACKEND_HPP
+
+#include <cstddef>     // std::size_t, std::ptrdiff_t, std::nullptr_t
+#include <cstdint>     // std::uint64_t
+#include <type_traits> // std::remove_extent_t, std::enable_if_t
+#include <utility>     // std::forward, std::swap
+
+#include <libpmemobj.h>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/transaction.hpp>
+#include <libpmemobj++/p.hpp>
+
+#include "emulation.hpp"
+
+namespace midas {
+namespace detail {
+
+namespace pmdk = pmem::obj;
+
+// ############################################################################
+// Storage backends
+//
+// The engine (store, index, histories, versions, strings) is written against
+// a backend policy instead of PMDK directly. A backend provides:
+//
+//   ptr<T>, p<T>, pool<Root>    pointer, property and pool types
+//   make, make_in, make_array   object creation (inside transactions)
+//   destroy, destroy_array      object destruction (inside transactions)
+//   exec_tx(pool, f)            runs f as a failure-atomic transaction
+//   snapshot(addr, size)        adds a range to the undo log of a transaction
+//   persist(pool, addr, size)   writes back a range that is not logged
+//   oid(addr)                   pool id and offset of an object
+//   address(anchor, offset)     object at an offset of the pool of anchor
+//   ctl_get/ctl_set             PMDK control interface (see pmemobj_ctl_get)
+//
+// PERSISTENT tells whether data lives in a PMDK pool.
+//
+// Offsets are what objects store to refer to each other in a single word
+// (see VersionChain, NVChunkList).
+// ############################################################################
+
+/**
+ * Keeps all data in a PMDK pool. Changes are failure-atomic and survive
+ * restarts.
+ */
+struct PersistentBackend
+{
+    static constexpr bool PERSISTENT = true;
+
+    template <class T> using ptr = pmdk::persistent_ptr<T>;
+    template <class T> using p = pmdk::p<T>;
+    template <class Root> using pool = pmdk::pool<Root>;
+
+    template <class T, class... Args>
+    static ptr<T> make(Args&&... args)
+    {
+        return pmdk::make_persistent<T>(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Creates an object from the given allocation class (see AllocClass)
+     * if the class is enabled for the given pool.
+     */
+    template <class Class, class T, class Pool, class... Args>
+    static ptr<T> make_in(Pool& pool, Args&&... args)
+    {
+        return Class::template make<T>(pool.handle(), std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    static ptr<T[]> make_array(const std::size_t count)
+    {
+        return pmdk::make_persistent<T[]>(count);
+    }
+
+    template <class T>
+    static void destroy(const ptr<T>& obj)
+    {
+        pmdk::delete_persistent<T>(obj);
+    }
+
+    template <class T>
+    static void destroy_array(const ptr<T[]>& obj, const std::size_t count)
+    {
+        pmdk::delete_persistent<T[]>(obj, count);
+    }
+
+    template <class Pool, class F>
+    static void exec_tx(Pool& pool, F&& tx)
+    {
+        pmdk::transaction::exec_tx(pool, std::forward<F>(tx));
+    }
+
+    static void snapshot(const void* addr, const std::size_t size)
+    {
+        pmemobj_tx_add_range_direct(addr, size);
+    }
+
+    template <class Pool>
+    static void persist(Pool& pool, const void* addr, const std::size_t size)
+    {
+        pool.persist(addr, size);
+    }
+
+    static PMEMoid oid(const void* addr) { return pmemobj_oid(addr); }
+
+    static char* address(const void* anchor, const std::uint64_t offset)
+    {
+        auto base = reinterpret_cast<char*>(const_cast<void*>(anchor)) -
+                pmemobj_oid(anchor).off;
+        return base + offset;
+    }
+
+    template <class Pool>
+    static int ctl_get(Pool& pool, const char* name, void* arg)
+    {
+        return pmemobj_ctl_get(pool.handle(), name, arg);
+    }
+
+    template <class Pool>
+    static int ctl_set(Pool& pool, const char* name, void* arg)
+    {
+        return pmemobj_ctl_set(pool.handle(), name, arg);
+    }
+};
+
+// ############################################################################
+// Volatile backend
+// ############################################################################
+
+/**
+ * A plain pointer with the interface of pmdk::persistent_ptr. Its "offset"
+ * is the address of the object in a pool that starts at address zero.
+ */
+template <class T>
+class VolatilePtr
+{
+public:
+    using element_type = std::remove_extent_t<T>;
+
+private:
+    element_type* mPtr;
+
+public:
+    VolatilePtr() : mPtr{nullptr} {}
+    VolatilePtr(std::nullptr_t) : mPtr{nullptr} {}
+    VolatilePtr(element_type* ptr) : mPtr{ptr} {}
+    VolatilePtr(const PMEMoid& oid)
+        : mPtr{reinterpret_cast<element_type*>(oid.off)}
+    {}
+
+    template <class Y, class = std::enable_if_t<std::is_convertible<Y*, T*>::value>>
+    VolatilePtr(const VolatilePtr<Y>& other) : mPtr{other.get()} {}
+
+    element_type* get() const { return mPtr; }
+    element_type* operator->() const { return mPtr; }
+    element_type& operator*() const { return *mPtr; }
+    element_type& operator[](const std::ptrdiff_t i) const { return mPtr[i]; }
+    explicit operator bool() const { return mPtr != nullptr; }
+
+    PMEMoid raw() const { return PMEMoid{0, reinterpret_cast<std::uint64_t>(mPtr)}; }
+
+    void swap(VolatilePtr& other) { std::swap(mPtr, other.mPtr); }
+
+    friend bool operator==(const VolatilePtr& a, const VolatilePtr& b) { return a.mPtr == b.mPtr; }
+    friend bool operator!=(const VolatilePtr& a, const VolatilePtr& b) { return a.mPtr != b.mPtr; }
+    friend bool operator<(const VolatilePtr& a, const VolatilePtr& b) { return a.mPtr < b.mPtr; }
+};
+
+/**
+ * A plain value with the interface of pmdk::p.
+ */
+template <class T>
+class VolatileP
+{
+private:
+    T mValue;
+
+public:
+    VolatileP() : mValue{} {}
+    VolatileP(const T& value) : mValue{value} {}
+
+    VolatileP& operator=(const T& value) { mValue = value; return *this; }
+
+    operator T() const { return mValue; }
+    const T& get_ro() const { return mValue; }
+    T& get_rw() { return mValue; }
+
+    void swap(VolatileP& other) { std::swap(mValue, other.mValue); }
+};
+
+/**
+ * Holds the root object of a volatile "pool". Objects are allocated on the
+ * heap as they are created, so there is no size limit and nothing has to be
+ * opened or closed. Nothing survives the process.
+ */
+template <class Root>
+class VolatilePool
+{
+private:
+    Root* mRoot;
+
+public:
+    VolatilePool() : mRoot{new Root()} {}
+    ~VolatilePool() { delete mRoot; }
+
+    VolatilePool(const VolatilePool& other) = delete;
+    VolatilePool& operator=(const VolatilePool& other) = delete;
+
+    VolatilePtr<Root> get_root() { return mRoot; }
+    void close() {}
+};
+
+/**
+ * Keeps all data on the heap. There are no flushes and no undo logs, so
+ * transactions are not failure-atomic. Meant for caching tiers and as a
+ * baseline for benchmarks.
+ */
+struct VolatileBackend
+{
+    static constexpr bool PERSISTENT = false;
+
+    template <class T> using ptr = VolatilePtr<T>;
+    template <class T> using p = VolatileP<T>;
+    template <class Root> using pool = VolatilePool<Root>;
+
+    template <class T, class... Args>
+    static ptr<T> make(Args&&... args)
+    {
+        return new T(std::forward<Args>(args)...);
+    }
+
+    template <class Class, class T, class Pool, class... Args>
+    static ptr<T> make_in(Pool& pool, Args&&... args)
+    {
+        (void)pool;
+        return make<T>(std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    static ptr<T[]> make_array(const std::size_t count)
+    {
+        return new T[count]();
+    }
+
+    template <class T>
+    static void destroy(const ptr<T>& obj)
+    {
+        delete obj.get();
+    }
+
+    template <class T>
+    static void destroy_array(const ptr<T[]>& obj, const std::size_t count)
+    {
+        (void)count;
+        delete[] obj.get();
+    }
+
+    template <class Pool, class F>
+    static void exec_tx(Pool& pool, F&& tx)
+    {
+        (void)pool;
+        tx();
+    }
+
+    static void snapshot(const void* addr, const std::size_t size)
+    {
+        (void)addr;
+        (void)size;
+    }
+
+    template <class Pool>
+    static void persist(Pool& pool, const void* addr, const std::size_t size)
+    {
+        (void)pool;
+        snapshot(addr, size);
+    }
+
+    static PMEMoid oid(const void* addr)
+    {
+        return PMEMoid{0, reinterpret_cast<std::uint64_t>(addr)};
+    }
+
+    static char* address(const void* anchor, const std::uint64_t offset)
+    {
+        (void)anchor;
+        return reinterpret_cast<char*>(offset);
+    }
+
+    template <class Pool>
+    static int ctl_get(Pool& pool, const char* name, void* arg)
+    {
+        (void)pool;
+        (void)name;
+        (void)arg;
+        return -1;
+    }
+
+    template <class Pool>
+    static int ctl_set(Pool& pool, const char* name, void* arg)
+    {
+        return ctl_get(pool, name, arg);
+    }
+};
+
+// ############################################################################
+// Emulated backend
+// ############################################################################
+
+/**
+ * A pmdk::persistent_ptr that charges a read (see MediaEmulator) whenever
+ * its target is accessed. The layout is the same, so a pool may be opened
+ * with and without emulation.
+ */
+template <class T>
+class EmulatedPtr : public pmdk::persistent_ptr<T>
+{
+private:
+    using base_type = pmdk::persistent_ptr<T>;
+
+public:
+    using element_type = typename base_type::element_type;
+
+    using base_type::base_type;
+    EmulatedPtr() = default;
+    EmulatedPtr(const base_type& other) : base_type{other} {}
+
+    element_type* get() const
+    {
+        MediaEmulator::read();
+        return base_type::get();
+    }
+
+    element_type* operator->() const { return get(); }
+    element_type& operator*() const { return *get(); }
+    element_type& operator[](const std::ptrdiff_t i) const { return get()[i]; }
+};
+
+/**
+ * Keeps all data in a PMDK pool like PersistentBackend, but adds the
+ * latencies of the device set in MediaEmulator. Meant for benchmarks on
+ * machines whose pools live in DRAM.
+ *
+ * The cost model follows PMDK transactions: every snapshot writes back its
+ * undo log entry and waits for it, and the outermost transaction writes
+ * back all snapshotted and allocated cache lines on commit, followed by a
+ * fence for the data and one for invalidating the log. Reads are charged
+ * per access to an object through a pointer or an offset.
+ */
+struct EmulatedBackend : PersistentBackend
+{
+    template <class T> using ptr = EmulatedPtr<T>;
+
+private:
+    // Nesting depth of transactions and cache lines to write back on commit
+    static inline thread_local std::size_t tDepth = 0;
+    static inline thread_local std::size_t tDirtyLines = 0;
+
+public:
+    template <class T, class... Args>
+    static ptr<T> make(Args&&... args)
+    {
+        tDirtyLines += MediaEmulator::lines(nullptr, sizeof(T));
+        return PersistentBackend::make<T>(std::forward<Args>(args)...);
+    }
+
+    template <class Class, class T, class Pool, class... Args>
+    static ptr<T> make_in(Pool& pool, Args&&... args)
+    {
+        tDirtyLines += MediaEmulator::lines(nullptr, sizeof(T));
+        return PersistentBackend::make_in<Class, T>(pool, std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    static ptr<T[]> make_array(const std::size_t count)
+    {
+        tDirtyLines += MediaEmulator::lines(nullptr, count * sizeof(T));
+        return PersistentBackend::make_array<T>(count);
+    }
+
+    template <class Pool, class F>
+    static void exec_tx(Pool& pool, F&& tx)
+    {
+        ++tDepth;
+        try {
+            PersistentBackend::exec_tx(pool, std::forward<F>(tx));
+        }
+        catch (...) {
+            // Rolling back writes back the same lines
+            commit();
+            throw;
+        }
+        commit();
+    }
+
+    static void snapshot(const void* addr, const std::size_t size)
+    {
+        const auto lines = MediaEmulator::lines(addr, size);
+        MediaEmulator::flush(lines);
+        MediaEmulator::fence();
+        tDirtyLines += lines;
+        PersistentBackend::snapshot(addr, size);
+    }
+
+    template <class Pool>
+    static void persist(Pool& pool, const void* addr, const std::size_t size)
+    {
+        MediaEmulator::flush(MediaEmulator::lines(addr, size));
+        MediaEmulator::fence();
+        PersistentBackend::persist(pool, addr, size);
+    }
+
+    static char* address(const void* anchor, const std::uint64_t offset)
+    {
+        MediaEmulator::read();
+        return PersistentBackend::address(anchor, offset);
+    }
+
+private:
+    static void commit()
+    {
+        if (--tDepth != 0)
+            return;
+
+        MediaEmulator::flush(tDirtyLines);
+        MediaEmulator::fence();
+        MediaEmulator::fence();
+        tDirtyLines = 0;
+    }
+};
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
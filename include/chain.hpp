@@ -0,0 +1,223 @@
+#ifndef MIDAS_CHAIN_HPP
+#define MIDAS_CHAIN_HPP
+
+#include <atomic>    // std::atomic
+#include <cstdint>   // std::uint64_t
+#include <stdexcept> // std::out_of_range
+
+#include "backend.hpp"
+#include "version.hpp"
+
+namespace midas {
+namespace detail {
+
+namespace pmdk = pmem::obj;
+
+/**
+ * A newest-first chain of versions that can be read without locking.
+ *
+ * Versions are linked intrusively through Version::next. Links are pool
+ * offsets rather than persistent pointers because an offset fits into a
+ * single word that can be loaded and swapped atomically (0 = end of chain).
+ *
+ * A new version is fully initialized before it is published by a single
+ * compare-and-swap on the head, so readers either see all of it or nothing.
+ *
+ * Removing versions is not synchronized with readers. The caller of erase()
+ * must make sure that no one else is accessing the chain at the same time.
+ *
+ * The chain owns its versions and deletes them when it is destroyed.
+ */
+template <class Backend>
+class BasicVersionChain
+{
+// ############################################################################
+// TYPES
+// ############################################################################
+
+public:
+    using this_type = BasicVersionChain<Backend>;
+    using offset_type = std::uint64_t;
+    using Version = BasicVersion<Backend>;
+    using version_ptr = typename Version::ptr;
+
+    class iterator;
+
+// ############################################################################
+// MEMBER VARIABLES
+// ############################################################################
+
+private:
+    std::atomic<offset_type> mHead;
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+public:
+    BasicVersionChain()
+        : mHead{0}
+    {}
+
+    // Chains are neither copied nor moved
+    BasicVersionChain(const this_type& other) = delete;
+    this_type& operator=(const this_type& other) = delete;
+
+    /**
+     * Destroys this chain and all its versions.
+     * Requires no transaction because dtors are always
+     * executed transactionally with delete_persistent()
+     */
+    ~BasicVersionChain()
+    {
+        auto curr = front();
+        while (curr) {
+            auto next = at(curr->next.load(std::memory_order_acquire));
+            Backend::template destroy<Version>(curr);
+            curr = next;
+        }
+    }
+
+    /**
+     * Publishes a version as the newest version of this chain, provided
+     * that the current newest version is the expected one (nullptr if the
+     * chain is expected to be empty).
+     *
+     * Others may publish on top of the version right away, so the head is
+     * not added to any undo log: rolling it back would unlink their
+     * versions. Hence, the version must be durable already (i.e. created
+     * by a transaction that has ended), and it stays in the chain even if
+     * the transaction that publishes it aborts. The head is written back
+     * before this returns.
+     *
+     * Returns false if the newest version is not the expected one.
+     */
+    template <class pool_type>
+    bool install(const version_ptr& version, const version_ptr& expected,
+                 pool_type& pool)
+    {
+        auto old_head = expected.raw().off;
+        version->next.store(old_head, std::memory_order_relaxed);
+        Backend::persist(pool, &version->next, sizeof(version->next));
+        if (!mHead.compare_exchange_strong(old_head, version.raw().off,
+                std::memory_order_acq_rel))
+            return false;
+        Backend::persist(pool, &mHead, sizeof(mHead));
+        return true;
+    }
+
+    /**
+     * Publishes a version as the newest version of this chain. The head is
+     * added to the undo log, so aborting the transaction also withdraws
+     * the version.
+     *
+     * Use only INSIDE active transactions and only with exclusive access.
+     */
+    template <class pool_type>
+    void push(const version_ptr& version, pool_type& pool)
+    {
+        (void)pool;
+        version->next.store(mHead.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        Backend::snapshot(&mHead, sizeof(mHead));
+        mHead.store(version.raw().off, std::memory_order_release);
+    }
+
+    /**
+     * Unlinks the version at the given position (without deleting it) and
+     * returns an iterator to the next older version.
+     *
+     * Use only INSIDE active transactions and only with exclusive access.
+     */
+    template <class pool_type>
+    iterator erase(iterator pos, pool_type& pool)
+    {
+        (void)pool;
+        if (pos == end())
+            throw std::out_of_range("iterator is out of range!");
+
+        const auto next = pos.curr->next.load(std::memory_order_acquire);
+        auto& link = pos.prev ? pos.prev->next : mHead;
+        Backend::snapshot(&link, sizeof(link));
+        link.store(next, std::memory_order_release);
+
+        pos.curr = at(next);
+        return pos;
+    }
+
+    /** Returns the newest version or nullptr if the chain is empty */
+    version_ptr front() const { return at(mHead.load(std::memory_order_acquire)); }
+
+    /** Returns true if the chain has no versions, false otherwise */
+    bool empty() const { return mHead.load(std::memory_order_acquire) == 0; }
+
+// ############################################################################
+// ITERATORS
+// ############################################################################
+
+    /**
+     * Forward iterator from newer to older versions
+     */
+    class iterator
+    {
+        friend this_type;
+
+    private:
+        const this_type* chain;
+        version_ptr prev;
+        version_ptr curr;
+
+    public:
+        explicit iterator(const this_type* chain = nullptr,
+                version_ptr curr = nullptr)
+            : chain(chain)
+            , prev{}
+            , curr{curr}
+        {}
+
+        version_ptr& operator*() { return curr; }
+        version_ptr* operator->() { return &curr; }
+
+        bool operator==(const iterator& other) { return curr == other.curr; }
+        bool operator!=(const iterator& other) { return curr != other.curr; }
+
+        iterator operator++(int) {
+            auto old = *this;
+            ++(*this);
+            return old;
+        }
+
+        iterator operator++() {
+            prev = curr;
+            curr = chain->at(curr->next.load(std::memory_order_acquire));
+            return *this;
+        }
+    };
+
+    iterator begin() const { return iterator{this, front()}; }
+    iterator end() const { return iterator{}; }
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+private:
+    /**
+     * Turns an offset into a pointer. Versions live in the same pool as
+     * the chain, so the pool id can be taken from the chain itself.
+     */
+    version_ptr at(const offset_type offset) const
+    {
+        if (offset == 0)
+            return nullptr;
+        return version_ptr{PMEMoid{Backend::oid(this).pool_uuid_lo, offset}};
+    }
+
+}; // end class BasicVersionChain
+
+using VersionChain = BasicVersionChain<PersistentBackend>;
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef MIDAS_CHANGE_LOG_HPP
+#define MIDAS_CHANGE_LOG_HPP
+
+#include <algorithm> // std::min
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint32_t, std::uint64_t
+#include <cstring>   // std::memcpy
+#include <string>    // std::string
+
+#include "backend.hpp"
+
+namespace midas {
+namespace detail {
+
+/**
+ * A persistent ring buffer of variable-sized records that discards its
+ * oldest records when it runs full.
+ *
+ * Records are addressed by positions, i.e. byte offsets from the start of
+ * the log that keep growing and are never reused. The records in the ring
+ * are those between begin() and end(). Each one is a 4-byte size followed
+ * by its bytes, wrapping around the end of the ring if needed.
+ *
+ * Appending never overwrites live records: room is made by evict() in a
+ * transaction of its own beforehand, so a crash or an abort during append()
+ * cannot damage records that were already there.
+ */
+template <class Backend = PersistentBackend>
+class NVChangeLog
+{
+// ############################################################################
+// TYPES
+// ############################################################################
+
+public:
+    using size_type = std::size_t;
+    using position_type = std::uint64_t;
+    using this_type = NVChangeLog<Backend>;
+
+    template <class U> using ptr = typename Backend::template ptr<U>;
+    template <class U> using p = typename Backend::template p<U>;
+
+private:
+    using record_size_type = std::uint32_t;
+
+// ############################################################################
+// MEMBER VARIABLES
+// ############################################################################
+
+private:
+    ptr<char[]> mData;
+    p<size_type> mCapacity;
+    p<position_type> mBegin;
+    p<position_type> mEnd;
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+public:
+    /**
+     * Creates an empty log of the given size in bytes whose first record
+     * will have the given position. Must be called in a transaction (e.g.
+     * through Backend::make).
+     */
+    explicit NVChangeLog(const size_type capacity, const position_type start = 0)
+        : mData{Backend::template make_array<char>(capacity)}
+        , mCapacity{capacity}
+        , mBegin{start}
+        , mEnd{start}
+    {}
+
+    NVChangeLog(const this_type& other) = delete;
+    this_type& operator=(const this_type& other) = delete;
+
+    ~NVChangeLog()
+    {
+        Backend::template destroy_array<char>(mData, mCapacity);
+    }
+
+    size_type capacity() const { return mCapacity; }
+
+    // Position of the oldest record
+    position_type begin() const { return mBegin; }
+
+    // Position after the newest record
+    position_type end() const { return mEnd; }
+
+    /**
+     * Returns the number of bytes a record of the given size takes up.
+     */
+    static size_type footprint(const size_type size)
+    {
+        return sizeof(record_size_type) + size;
+    }
+
+    /**
+     * Tests whether a record of the given size fits into the log at all.
+     */
+    bool fits(const size_type size) const
+    {
+        return footprint(size) <= mCapacity.get_ro();
+    }
+
+    /**
+     * Discards the oldest records until the given number of bytes (at most
+     * the capacity) is free.
+     */
+    template <class pool_type>
+    void evict(const size_type bytes, pool_type& pool)
+    {
+        if (free() >= bytes)
+            return;
+
+        Backend::exec_tx(pool, [&,this](){
+            auto begin = mBegin.get_ro();
+            while (mCapacity.get_ro() - (mEnd.get_ro() - begin) < bytes) {
+                record_size_type size;
+                copyOut(begin, &size, sizeof(size));
+                begin += footprint(size);
+            }
+            mBegin.get_rw() = begin;
+        });
+    }
+
+    /**
+     * Discards all records and moves the log forward by the given number of
+     * bytes, as if records of that size had been appended and evicted.
+     */
+    template <class pool_type>
+    void skip(const size_type bytes, pool_type& pool)
+    {
+        Backend::exec_tx(pool, [&,this](){
+            mEnd.get_rw() = mEnd.get_ro() + bytes;
+            mBegin.get_rw() = mEnd.get_ro();
+        });
+    }
+
+    /**
+     * Appends a record. The record must fit into the free part of the log
+     * (see evict). Its bytes are written back right away and the record
+     * becomes part of the log when the enclosing transaction commits.
+     */
+    template <class pool_type>
+    void append(const std::string& record, pool_type& pool)
+    {
+        const auto size = static_cast<record_size_type>(record.size());
+        const auto end = mEnd.get_ro();
+        copyIn(end, &size, sizeof(size), pool);
+        copyIn(end + sizeof(size), record.data(), record.size(), pool);
+
+        Backend::exec_tx(pool, [&,this](){
+            mEnd.get_rw() = end + footprint(size);
+        });
+    }
+
+    /**
+     * Copies the record at the given position, which must be between
+     * begin() and end(), and moves the position to the next record.
+     */
+    void read(position_type& position, std::string& record) const
+    {
+        record_size_type size;
+        copyOut(position, &size, sizeof(size));
+        record.resize(size);
+        copyOut(position + sizeof(size), &record[0], size);
+        position += footprint(size);
+    }
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+private:
+    size_type free() const
+    {
+        return mCapacity.get_ro() - (mEnd.get_ro() - mBegin.get_ro());
+    }
+
+    template <class pool_type>
+    void copyIn(const position_type position, const void* src, const size_type size,
+            pool_type& pool)
+    {
+        const auto capacity = mCapacity.get_ro();
+        const auto offset = position % capacity;
+        const auto first = std::min(size, capacity - offset);
+        auto data = mData.get();
+        std::memcpy(data + offset, src, first);
+        Backend::persist(pool, data + offset, first);
+        if (first < size) {
+            std::memcpy(data, static_cast<const char*>(src) + first, size - first);
+            Backend::persist(pool, data, size - first);
+        }
+    }
+
+    void copyOut(const position_type position, void* dst, const size_type size) const
+    {
+        const auto capacity = mCapacity.get_ro();
+        const auto offset = position % capacity;
+        const auto first = std::min(size, capacity - offset);
+        const auto data = mData.get();
+        std::memcpy(dst, data + offset, first);
+        if (first < size)
+            std::memcpy(static_cast<char*>(dst) + first, data, size - first);
+    }
+};
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
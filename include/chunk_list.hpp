@@ -0,0 +1,400 @@
+#ifndef MIDAS_CHUNK_LIST_HPP
+#define MIDAS_CHUNK_LIST_HPP
+
+#include <stdexcept> // std::out_of_range
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint64_t
+
+#include "alloc_class.hpp"
+#include "backend.hpp"
+
+namespace midas {
+namespace detail {
+
+namespace pmdk = pmem::obj;
+
+/**
+ * An unordered list of persistent pointers that stores several elements
+ * per node (unrolled list).
+ *
+ * Elements and links are stored as 8-byte pool offsets instead of 16-byte
+ * persistent pointers, so a node of NodeSize bytes holds (NodeSize / 8 - 2)
+ * elements. All nodes but the first and the last one are full. Appending
+ * fills the last node and erasing moves the last element into the gap, so
+ * there are no O(n) walks except for finding a new last node when one
+ * becomes empty.
+ *
+ * The order of elements is not preserved when erasing. A list that is only
+ * appended to and shrinks through erase_front() keeps its nodes in the
+ * order in which they were filled, though.
+ *
+ * T must be a pointer of the backend to objects of the same pool as the list.
+ */
+template <class T, class Backend = PersistentBackend, std::size_t NodeSize = 64>
+class NVChunkList
+{
+// ############################################################################
+// TYPES
+// ############################################################################
+
+public:
+    using elem_type = T;
+    using size_type = std::size_t;
+    using offset_type = std::uint64_t;
+    using this_type = NVChunkList<elem_type, Backend, NodeSize>;
+
+    template <class U> using ptr = typename Backend::template ptr<U>;
+    template <class U> using p = typename Backend::template p<U>;
+
+    // Number of elements per node
+    static constexpr size_type CAPACITY = NodeSize / sizeof(offset_type) - 2;
+    static_assert(CAPACITY > 0, "NodeSize is too small");
+
+    class iterator;
+
+private:
+    /**
+     * A node with a link to its successor, the number of used slots and
+     * the slots themselves. Fills exactly NodeSize bytes.
+     */
+    struct node
+    {
+        node()
+            : mNext{0}
+            , mCount{0}
+        {}
+
+        p<offset_type> mNext;
+        p<size_type> mCount;
+        p<offset_type> mSlots[CAPACITY];
+    };
+
+// ############################################################################
+// MEMBER VARIABLES
+// ############################################################################
+
+private:
+    p<offset_type> mHead;
+    p<offset_type> mTail;
+    p<size_type> mSize;
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+public:
+    NVChunkList()
+        : mHead{0}
+        , mTail{0}
+        , mSize{0}
+    {}
+
+    NVChunkList(const this_type& other) = delete;
+    this_type& operator=(const this_type& other) = delete;
+
+    /**
+     * Destroys this list and all its nodes (but not the elements).
+     * Requires no transaction because dtors are always
+     * executed transactionally with delete_persistent()
+     */
+    ~NVChunkList()
+    {
+        clear();
+    }
+
+    /**
+     * Adds an element to this list.
+     */
+    template <class pool_type>
+    void push_back(const elem_type& elem, pool_type& pool)
+    {
+        Backend::exec_tx(pool, [&,this](){
+            auto tail = at(mTail.get_ro());
+            if (!tail || tail->mCount.get_ro() == CAPACITY) {
+                auto new_node = makeNode(pool);
+                const auto offset = new_node.raw().off;
+                if (tail)
+                    tail->mNext.get_rw() = offset;
+                else
+                    mHead.get_rw() = offset;
+                mTail.get_rw() = offset;
+                tail = new_node.get();
+            }
+            auto& count = tail->mCount.get_rw();
+            tail->mSlots[count].get_rw() = elem.raw().off;
+            ++count;
+            ++mSize.get_rw();
+        });
+    }
+
+    /**
+     * Removes the element at the given position by moving the last
+     * element of this list into its slot.
+     *
+     * Returns an iterator to the element that now occupies the position
+     * (which was not visited yet) or to the next node or end(). Hence,
+     * erasing while iterating visits every element exactly once.
+     */
+    template <class pool_type>
+    iterator erase(iterator pos, pool_type& pool)
+    {
+        if (pos == end())
+            throw std::out_of_range("iterator is out of range!");
+
+        Backend::exec_tx(pool, [&,this](){
+            auto tail = at(mTail.get_ro());
+            auto& count = tail->mCount.get_rw();
+            --count;
+
+            // Fill the gap unless the last element itself is erased
+            const auto isLast = pos.curr == tail && pos.index == count;
+            if (!isLast)
+                pos.curr->mSlots[pos.index].get_rw() =
+                        tail->mSlots[count].get_ro();
+
+            if (count == 0)
+                removeTail();
+            --mSize.get_rw();
+
+            if (isLast)
+                pos = end();
+            else
+                pos.load();
+        });
+        return pos;
+    }
+
+    /**
+     * Removes the given element from the first node by moving the last
+     * element of that node into its slot, and deletes the node once it is
+     * empty. Neither walks the list nor touches later nodes.
+     *
+     * Returns false if the first node does not hold the element.
+     */
+    template <class pool_type>
+    bool erase_front(const elem_type& elem, pool_type& pool)
+    {
+        auto head = at(mHead.get_ro());
+        if (!head)
+            return false;
+
+        const auto offset = elem.raw().off;
+        const auto count = head->mCount.get_ro();
+        size_type index = 0;
+        while (index < count && head->mSlots[index].get_ro() != offset)
+            ++index;
+        if (index == count)
+            return false;
+
+        Backend::exec_tx(pool, [&,this](){
+            if (index != count - 1)
+                head->mSlots[index].get_rw() = head->mSlots[count - 1].get_ro();
+            head->mCount.get_rw() = count - 1;
+            --mSize.get_rw();
+            if (count == 1) {
+                const auto first = mHead.get_ro();
+                mHead.get_rw() = head->mNext.get_ro();
+                if (mTail.get_ro() == first)
+                    mTail.get_rw() = 0;
+                Backend::template destroy<node>(nodePtr(first));
+            }
+        });
+        return true;
+    }
+
+    /**
+     * Removes all elements in this list.
+     */
+    template <class pool_type>
+    void clear(pool_type& pool)
+    {
+        Backend::exec_tx(pool, [&,this](){
+            clear();
+            mHead.get_rw() = 0;
+            mTail.get_rw() = 0;
+            mSize.get_rw() = 0;
+        });
+    }
+
+    /**
+     * Requests the first node of this list from memory (if any) without
+     * waiting for it.
+     */
+    void prefetch() const
+    {
+        const auto head = mHead.get_ro();
+        if (head)
+            __builtin_prefetch(address(head));
+    }
+
+    /**
+     * Returns number of elements in the list.
+     */
+    size_type size() const { return mSize.get_ro(); }
+
+    /**
+     * Returns true if the list has no elements, false otherwise.
+     */
+    bool empty() const { return mSize.get_ro() == 0; }
+
+// ############################################################################
+// ITERATORS
+// ############################################################################
+
+    /**
+     * Iterates over all elements, node by node. Elements are materialized as
+     * persistent pointers when they are visited, so they must not be
+     * assigned through an iterator.
+     */
+    class iterator
+    {
+        friend this_type;
+
+    private:
+        const this_type* list;
+        node* curr;
+        size_type index;
+        elem_type value;
+
+    public:
+        explicit iterator(const this_type* list = nullptr, node* curr = nullptr)
+            : list(list)
+            , curr(curr)
+            , index(0)
+            , value{}
+        {
+            if (curr) {
+                prefetch();
+                load();
+            }
+        }
+
+        elem_type& operator*() { return value; }
+        elem_type* operator->() { return &value; }
+
+        bool operator==(const iterator& other)
+        {
+            return curr == other.curr && index == other.index;
+        }
+
+        bool operator!=(const iterator& other) { return !(*this == other); }
+
+        iterator operator++(int) {
+            auto old = *this;
+            ++(*this);
+            return old;
+        }
+
+        iterator operator++() {
+            if (++index == curr->mCount.get_ro()) {
+                curr = list->at(curr->mNext.get_ro());
+                index = 0;
+                if (curr)
+                    prefetch();
+            }
+            if (curr)
+                load();
+            return *this;
+        }
+
+    private:
+        void load()
+        {
+            value = elem_type{PMEMoid{list->uuid(), curr->mSlots[index].get_ro()}};
+        }
+
+        /**
+         * All elements of a node are known as soon as the node is loaded,
+         * so their targets are requested at once instead of one at a time.
+         */
+        void prefetch()
+        {
+            const auto next = list->at(curr->mNext.get_ro());
+            if (next)
+                __builtin_prefetch(next);
+
+            const auto count = curr->mCount.get_ro();
+            for (size_type i=0; i<count; ++i)
+                __builtin_prefetch(list->address(curr->mSlots[i].get_ro()));
+        }
+    };
+
+    iterator begin() const { return iterator{this, at(mHead.get_ro())}; }
+    iterator end() const { return iterator{}; }
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+private:
+    /**
+     * Returns the object at the given offset. Nodes and elements live in
+     * the same pool as this list, so offsets are relative to it.
+     */
+    const char* address(const offset_type offset) const
+    {
+        return Backend::address(this, offset);
+    }
+
+    std::uint64_t uuid() const { return Backend::oid(this).pool_uuid_lo; }
+
+    node* at(const offset_type offset) const
+    {
+        if (offset == 0)
+            return nullptr;
+        return reinterpret_cast<node*>(const_cast<char*>(address(offset)));
+    }
+
+    ptr<node> nodePtr(const offset_type offset) const
+    {
+        return ptr<node>{PMEMoid{uuid(), offset}};
+    }
+
+    /**
+     * Nodes of one cache line have an allocation class of their own.
+     */
+    template <class pool_type>
+    static ptr<node> makeNode(pool_type& pool)
+    {
+        if constexpr (sizeof(node) == LineAllocClass::SIZE)
+            return Backend::template make_in<LineAllocClass, node>(pool);
+        else
+            return Backend::template make<node>();
+    }
+
+    /**
+     * Unlinks and deletes the (empty) last node.
+     */
+    void removeTail()
+    {
+        const auto tail = mTail.get_ro();
+        if (mHead.get_ro() == tail) {
+            mHead.get_rw() = 0;
+            mTail.get_rw() = 0;
+        }
+        else {
+            auto prev = at(mHead.get_ro());
+            while (prev->mNext.get_ro() != tail)
+                prev = at(prev->mNext.get_ro());
+            prev->mNext.get_rw() = 0;
+            mTail.get_rw() = Backend::oid(prev).off;
+        }
+        Backend::template destroy<node>(nodePtr(tail));
+    }
+
+    void clear()
+    {
+        auto curr = mHead.get_ro();
+        while (curr) {
+            const auto next = at(curr)->mNext.get_ro();
+            Backend::template destroy<node>(nodePtr(curr));
+            curr = next;
+        }
+    }
+
+}; // end class NVChunkList
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef MIDAS_EMULATION_HPP
+#define MIDAS_EMULATION_HPP
+
+#include <atomic>  // std::atomic
+#include <chrono>  // std::chrono::steady_clock
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint32_t, std::uintptr_t
+
+namespace midas {
+namespace detail {
+
+/**
+ * Latencies of a persistent memory device on top of the DRAM the pool
+ * actually lives in (e.g. a file on tmpfs). All latencies are in
+ * nanoseconds.
+ */
+struct MediaProfile {
+    const char* name;
+
+    // Extra latency of reading a persistent object
+    std::uint32_t readLatency;
+
+    // Latency of writing back one cache line (clwb)
+    std::uint32_t flushLatency;
+
+    // Latency of waiting for all write-backs to complete (sfence)
+    std::uint32_t fenceLatency;
+};
+
+namespace media {
+
+// No extra latencies, i.e. the pool is as fast as DRAM
+constexpr MediaProfile DRAM{"dram", 0, 0, 0};
+
+// Intel Optane DC persistent memory in App Direct mode
+constexpr MediaProfile OPTANE{"optane", 200, 100, 100};
+
+// Battery-backed DRAM (NVDIMM-N): reads at DRAM speed, costly write-backs
+constexpr MediaProfile NVDIMM{"nvdimm", 0, 50, 50};
+
+// Pessimistic device for testing sensitivity to latency
+constexpr MediaProfile SLOW{"slow", 1000, 500, 500};
+
+constexpr MediaProfile ALL[] = {DRAM, NVDIMM, OPTANE, SLOW};
+
+} // end namespace media
+
+/**
+ * Injects the latencies of an emulated device into the persistence paths
+ * of Midas (see EmulatedBackend). Delays are spent busy-waiting on the
+ * calling thread, just like a stalled load or fence would.
+ *
+ * The profile applies to all pools of the process and must be set while no
+ * store is running. Emulation is off until a profile is set.
+ */
+class MediaEmulator
+{
+public:
+    static constexpr std::size_t CACHE_LINE = 64;
+
+private:
+    static inline MediaProfile sProfile = media::DRAM;
+    static inline std::atomic<bool> sActive{false};
+
+public:
+    static void setProfile(const MediaProfile& profile)
+    {
+        sProfile = profile;
+        sActive.store(profile.readLatency || profile.flushLatency ||
+                profile.fenceLatency);
+    }
+
+    static const MediaProfile& profile() { return sProfile; }
+
+    static bool active() { return sActive.load(std::memory_order_relaxed); }
+
+    /**
+     * Charges the read of one persistent object.
+     */
+    static void read()
+    {
+        if (active())
+            delay(sProfile.readLatency);
+    }
+
+    /**
+     * Returns the number of cache lines spanned by the given range.
+     */
+    static std::size_t lines(const void* addr, const std::size_t size)
+    {
+        if (size == 0)
+            return 0;
+
+        const auto first = reinterpret_cast<std::uintptr_t>(addr) / CACHE_LINE;
+        const auto last = (reinterpret_cast<std::uintptr_t>(addr) + size - 1) / CACHE_LINE;
+        return last - first + 1;
+    }
+
+    /**
+     * Charges the write-back of the given number of cache lines.
+     */
+    static void flush(const std::size_t lines)
+    {
+        if (active())
+            delay(lines * sProfile.flushLatency);
+    }
+
+    /**
+     * Charges a fence.
+     */
+    static void fence()
+    {
+        if (active())
+            delay(sProfile.fenceLatency);
+    }
+
+private:
+    static void delay(const std::uint64_t nanos)
+    {
+        if (nanos == 0)
+            return;
+
+        const auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(nanos);
+        while (std::chrono::steady_clock::now() < until)
+            ;
+    }
+};
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef MIDAS_HASH_HPP
+#define MIDAS_HASH_HPP
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <cstring> // std::memcpy
+
+namespace midas {
+namespace detail {
+
+// ############################################################################
+// Byte hash policies for index keys. A policy maps a sequence of bytes to a
+// 64-bit hash through a static function hash(const char*, std::size_t).
+//
+// All policies are free of persistent state because the index stores bucket
+// positions implicitly. Hence, any policy (and seed) must stay the same for
+// the lifetime of a pool, otherwise existing keys can no longer be found.
+// ############################################################################
+
+/**
+ * The original polynomial hash (hash * 101 + c). It consumes one byte per
+ * iteration and its low bits depend almost entirely on the last few bytes of
+ * the key, so keys that only differ in a prefix or in a counter suffix pile
+ * up in few buckets of a power-of-two table. Kept for comparison.
+ */
+struct PolynomialHash {
+    static std::uint64_t hash(const char* str, std::size_t size)
+    {
+        std::uint64_t hash = 0;
+        for (std::size_t i=0; i<size; ++i)
+            hash = hash * 101 + *str++;
+        return hash;
+    }
+};
+
+/**
+ * A multiply-fold hash that consumes keys in 16-byte strides (two
+ * independent 64-bit lanes per step), followed by at most one 8-byte
+ * stride and a short tail.
+ *
+ * Each step multiplies two 64-bit words into a 128-bit product and folds the
+ * halves together, so every input bit affects all output bits including the
+ * low bits used by the power-of-two bucket arrays.
+ *
+ * The seed is a compile-time parameter because it must not change for the
+ * lifetime of a pool (see above).
+ */
+template <std::uint64_t Seed = 0>
+struct StrideHash {
+    static std::uint64_t hash(const char* str, std::size_t size)
+    {
+        const auto* p = reinterpret_cast<const unsigned char*>(str);
+        std::uint64_t a = Seed ^ mix(Seed ^ P0, P1);
+        std::uint64_t b = a ^ P2;
+        std::size_t left = size;
+
+        // 16-byte strides. Both lanes are independent so their
+        // multiplications can be executed in parallel.
+        while (left >= 16) {
+            a = mix(load64(p) ^ P1, a ^ load64(p + 8));
+            b = mix(load64(p + 8) ^ P2, b ^ load64(p));
+            p += 16;
+            left -= 16;
+        }
+
+        // At most one 8-byte stride
+        if (left >= 8) {
+            a = mix(load64(p) ^ P1, a);
+            p += 8;
+            left -= 8;
+        }
+
+        // Remaining 0-7 bytes are packed into a single word
+        std::uint64_t tail = 0;
+        if (left >= 4) {
+            tail = (load32(p) << 32) | load32(p + left - 4);
+        }
+        else if (left > 0) {
+            tail = (std::uint64_t{p[0]} << 16) | (std::uint64_t{p[left >> 1]} << 8)
+                | p[left - 1];
+        }
+
+        // Merge lanes and mix in the length to separate keys that
+        // only differ in trailing zero bytes
+        return mix(a ^ tail ^ P3, b ^ (static_cast<std::uint64_t>(size) * P0));
+    }
+
+private:
+    static constexpr std::uint64_t P0 = 0xa0761d6478bd642fULL;
+    static constexpr std::uint64_t P1 = 0xe7037ed1a0b428dbULL;
+    static constexpr std::uint64_t P2 = 0x8ebc6af09c88c6e3ULL;
+    static constexpr std::uint64_t P3 = 0x589965cc75374cc3ULL;
+
+    static std::uint64_t mix(const std::uint64_t x, const std::uint64_t y)
+    {
+        const auto r = static_cast<unsigned __int128>(x) * y;
+        return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+    }
+
+    // Unaligned loads. Compilers turn these into plain moves.
+    static std::uint64_t load64(const unsigned char* p)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static std::uint64_t load32(const unsigned char* p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+};
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
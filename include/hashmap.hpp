@@ -3,16 +3,12 @@
 
 #include <cstddef>   // std::size_t
 #include <utility>   // std::swap
+#include <algorithm> // std::min
+#include <vector>    // std::vector
 #include <iostream>  // std::cout, std::endl (debugging)
 
-#include <libpmemobj++/pool.hpp>
-#include <libpmemobj++/make_persistent_array.hpp>
-#include <libpmemobj++/make_persistent.hpp>
-#include <libpmemobj++/persistent_ptr.hpp>
-#include <libpmemobj++/transaction.hpp>
-#include <libpmemobj++/p.hpp>
-
-#include "list.hpp"
+#include "backend.hpp"
+#include "chunk_list.hpp"
 #include "string.hpp"
 
 namespace midas {
@@ -27,9 +23,11 @@ struct DefaultHashmapConfig {
     static constexpr size_type INIT_SIZE = 64;
     static constexpr size_type GROW_FACTOR = 2;
     static constexpr float_type MAX_LOAD_FACTOR = 0.75;
+    static constexpr float_type MIN_LOAD_FACTOR = 0.25;
 };
 
-template <class Hash, class T, class Config = DefaultHashmapConfig>
+template <class Hash, class T, class Config = DefaultHashmapConfig,
+          class Backend = PersistentBackend>
 class NVHashmap
 {
 
@@ -41,7 +39,11 @@ public:
     using hash_type = Hash;
     using mapped_type = T;
     using size_type = std::size_t;
-    using this_type = NVHashmap<Hash, T, Config>;
+    using float_type = typename Config::float_type;
+    using this_type = NVHashmap<Hash, T, Config, Backend>;
+
+    template <class U> using ptr = typename Backend::template ptr<U>;
+    template <class U> using p = typename Backend::template p<U>;
 
     // Keys of this type are only used for queries but are never stored.
     // When storing keys, volatile keys are copied into persistent keys.
@@ -56,7 +58,7 @@ public:
 
     // A persistent key-value pair.
     // The type of values is arbitrary but it is strongly recommended to use
-    // pmdk::p<X> for primitives and pmdk::persistent_ptr<X> for classes/PODs.
+    // p<X> for primitives and ptr<X> for classes/PODs (see the Backend).
     struct pair
     {
         pair()
@@ -64,22 +66,24 @@ public:
             , value{}
         {}
 
-        pmdk::p<persistent_key> key;
+        p<persistent_key> key;
         mapped_type value;
     };
 
     // Each bucket stores key-value pairs of equally-hashing keys.
-    // In this case, each bucket is simply a list of pair pointers.
-    using bucket_type = NVList<pmdk::persistent_ptr<pair>>;
+    // In this case, each bucket is simply a list of pair pointers. Buckets
+    // are short, so a single 64-byte node (six pairs) usually holds all of
+    // them and a lookup touches one cache line before reaching the pairs.
+    using bucket_type = NVChunkList<ptr<pair>, Backend>;
 
 // ############################################################################
 // MEMBER VARIABLES
 // ############################################################################
 
 private:
-    pmdk::persistent_ptr<bucket_type[]> mBuckets; // holds buckets of this table
-    pmdk::p<size_type> mBucketCount; // number of buckets in this table
-    pmdk::p<size_type> mElemCount; // number of elements in this table
+    ptr<bucket_type[]> mBuckets; // holds buckets of this table
+    p<size_type> mBucketCount; // number of buckets in this table
+    p<size_type> mElemCount; // number of elements in this table
 
 // ############################################################################
 // PUBLIC API
@@ -106,7 +110,7 @@ public:
 
     ~NVHashmap()
     {
-        pmdk::delete_persistent<bucket_type[]>(mBuckets, mBucketCount);
+        Backend::template destroy_array<bucket_type>(mBuckets, mBucketCount);
     }
 
     this_type& operator=(const this_type& other) = delete;
@@ -133,13 +137,13 @@ public:
      */
     template <class pool_type>
     bool put(const volatile_key& key, const mapped_type& value,
-             pmdk::pool<pool_type>& pool)
+             pool_type& pool)
     {
         // Allocate the table if there are no buckets yet
         if (!mBuckets) {
-            pmdk::transaction::exec_tx(pool, [&,this](){
+            Backend::exec_tx(pool, [&,this](){
                 mBuckets =
-                    pmdk::make_persistent<bucket_type[]>(Config::INIT_SIZE);
+                    Backend::template make_array<bucket_type>(Config::INIT_SIZE);
                 mBucketCount.get_rw() = Config::INIT_SIZE;
             });
         }
@@ -153,10 +157,10 @@ public:
                 return false;
 
         // Insert new elem at the back of the bucket
-        pmdk::transaction::exec_tx(pool, [&,this](){
+        Backend::exec_tx(pool, [&,this](){
 
             // Create new pair
-            const auto new_pair = pmdk::make_persistent<pair>();
+            const auto new_pair = Backend::template make<pair>();
 
             // Convert volatile key to persistent key and store in pair
             new_pair->key.get_rw() = key;
@@ -205,6 +209,53 @@ public:
         return false;
     }
 
+    /**
+     * Retrieves the values for several keys at once.
+     *
+     * Instead of one key after another, each step of the lookup is done for
+     * all keys before the next step: hashing, loading bucket headers and
+     * loading the first node of each bucket. Every step requests the memory
+     * needed by the next one, so the loads of different keys overlap.
+     *
+     * The i-th value is set if the i-th key was found and default-constructed
+     * otherwise, so mapped types should have a distinguishable default value
+     * (e.g. a null pointer).
+     *
+     * Returns the number of keys that were found.
+     */
+    size_type get(const std::vector<volatile_key>& keys,
+                  std::vector<mapped_type>& values) const
+    {
+        const auto count = keys.size();
+        values.assign(count, mapped_type{});
+        if (!mBuckets)
+            return 0;
+
+        // Hash all keys and request their bucket headers
+        std::vector<bucket_type*> buckets(count);
+        for (size_type i=0; i<count; ++i) {
+            buckets[i] = &mBuckets[hash(keys[i])];
+            __builtin_prefetch(buckets[i]);
+        }
+
+        // Request the first node of each bucket
+        for (const auto bucket : buckets)
+            bucket->prefetch();
+
+        // Scan buckets. Entering a node requests all its pairs at once.
+        size_type found = 0;
+        for (size_type i=0; i<count; ++i) {
+            for (const auto& elem : *buckets[i]) {
+                if (elem->key.get_ro() == keys[i]) {
+                    values[i] = elem->value;
+                    ++found;
+                    break;
+                }
+            }
+        }
+        return found;
+    }
+
     /**
      * Removes a key-value pair with the given key (if any).
      *
@@ -214,10 +265,12 @@ public:
      * If no table has been allocated before, then this method has no effect
      * and returns false.
      *
+     * The pair is freed but not the object a mapped pointer refers to.
+     *
      * Returns true if the given pair was removed successfully.
      */
     template <class pool_type>
-    bool erase(const volatile_key& key, pmdk::pool<pool_type>& pool)
+    bool erase(const volatile_key& key, pool_type& pool)
     {
         // Return if there are no buckets yet
         if (!mBuckets)
@@ -230,10 +283,17 @@ public:
         const auto end = bucket.end();
         for (auto it = bucket.begin(); it != end; ++it) {
             if ((*it)->key.get_ro() == key) {
-                pmdk::transaction::exec_tx(pool, [&,this](){
+                Backend::exec_tx(pool, [&,this](){
+                    const auto removed = *it;
                     bucket.erase(it, pool);
+                    Backend::template destroy<pair>(removed);
                     --mElemCount.get_rw();
                 });
+
+                // Contract table when minimum load factor is undercut
+                if (load() < Config::MIN_LOAD_FACTOR)
+                    shrink(pool);
+
                 return true;
             }
         }
@@ -250,27 +310,29 @@ public:
      * Returns incremented iterator if iterator is valid, identity otherwise.
      */
     template <class pool_type>
-    iterator erase(iterator& it, pmdk::pool<pool_type>& pool)
+    iterator erase(iterator& it, pool_type& pool)
     {
         // Return if there are no buckets yet
         if (it == end())
             return it;
 
-        // Get info to locate current bucket item
-        auto bucket_it = it.bucket_iter;
-        auto table_idx = it.table_index;
-
-        // Go to next bucket item to avoid invalidation and provide the caller
-        // with a usable iterator to proceed. Still, the iterator could be at
-        // its end, so the caller is in charge of testing for end().
-        ++it;
-
-        // Remove previous bucket item
-        auto& bucket = mBuckets[table_idx];
-        pmdk::transaction::exec_tx(pool, [&,this](){
-            bucket.erase(bucket_it, pool);
+        // Remove current bucket item. Buckets move another item into its
+        // place, so the bucket iterator remains usable for the caller to
+        // proceed unless the bucket has no items left to visit.
+        auto& bucket = mBuckets[it.table_index];
+        Backend::exec_tx(pool, [&,this](){
+            const auto removed = *it.bucket_iter;
+            it.bucket_iter = bucket.erase(it.bucket_iter, pool);
+            Backend::template destroy<pair>(removed);
             --mElemCount.get_rw();
         });
+
+        // Still, the iterator could be at its end, so the caller is in
+        // charge of testing for end().
+        if (it.bucket_iter == it.bucket_end) {
+            ++it.table_index;
+            it.seek();
+        }
         return it;
     }
 
@@ -281,7 +343,7 @@ public:
      * Does nothing if the number of buckets or the number of items is zero.
      */
     template <class pool_type>
-    void clear(pmdk::pool<pool_type>& pool)
+    void clear(pool_type& pool)
     {
         const auto numBuckets = mBucketCount.get_ro();
         const auto numElems = mElemCount.get_ro();
@@ -290,14 +352,69 @@ public:
         if (numBuckets == 0 || numElems == 0)
             return;
 
-        pmdk::transaction::exec_tx(pool, [&,this](){
-            for (size_type i=0; i<numBuckets; ++i)
-                if (!mBuckets[i].empty())
+        Backend::exec_tx(pool, [&,this](){
+            for (size_type i=0; i<numBuckets; ++i) {
+                if (!mBuckets[i].empty()) {
+                    for (auto& elem : mBuckets[i])
+                        Backend::template destroy<pair>(elem);
                     mBuckets[i].clear(pool);
+                }
+            }
             mElemCount.get_rw() = 0;
         });
     }
 
+    /**
+     * Prepares the table for holding at least the given number of elements
+     * without exceeding the maximum load factor.
+     *
+     * Allocates the table if none was created yet. Otherwise, the table is
+     * expanded in a single step (one rehash at most) as opposed to the series
+     * of expansions that would be triggered by put().
+     *
+     * Does nothing if the table is large enough already.
+     */
+    template <class pool_type>
+    void reserve(const size_type count, pool_type& pool)
+    {
+        // Find the smallest table size reachable by regular growth
+        size_type target = mBuckets ? mBucketCount.get_ro() : Config::INIT_SIZE;
+        while (static_cast<float_type>(count) / target > Config::MAX_LOAD_FACTOR)
+            target *= Config::GROW_FACTOR;
+
+        if (!mBuckets) {
+            Backend::exec_tx(pool, [&,this](){
+                mBuckets = Backend::template make_array<bucket_type>(target);
+                mBucketCount.get_rw() = target;
+            });
+        }
+        else if (target > mBucketCount.get_ro()) {
+            resize(target, pool);
+        }
+    }
+
+    /**
+     * Reduces the table to the smallest size reachable by regular growth
+     * that holds all elements without exceeding the maximum load factor.
+     * All buckets are repacked in a single rehash.
+     *
+     * This happens automatically in erase() when the load drops below the
+     * minimum load factor, but not when erasing through iterators (which
+     * would invalidate them). Call this after such mass deletions.
+     *
+     * Does nothing if the table cannot become smaller.
+     */
+    template <class pool_type>
+    void shrink_to_fit(pool_type& pool)
+    {
+        if (!mBuckets)
+            return;
+
+        const auto target = fit(size(), Config::MAX_LOAD_FACTOR);
+        if (target < mBucketCount.get_ro())
+            resize(target, pool);
+    }
+
     /** Returns the number of buckets in this table */
     size_type buckets() const { return mBucketCount; }
 
@@ -337,7 +454,7 @@ public:
         using elem_type = typename bucket_type::elem_type;
 
     private:
-        pmdk::persistent_ptr<bucket_type[]> table;
+        ptr<bucket_type[]> table;
         size_type table_size;
 
         size_type table_index;
@@ -353,11 +470,12 @@ public:
             , bucket_end{}
         {}
 
-        iterator(pmdk::persistent_ptr<bucket_type[]> table,
-                size_type table_size)
+        // Iterates over buckets [table_index, table_size)
+        iterator(ptr<bucket_type[]> table,
+                size_type table_size, size_type table_index = 0)
             : table(table)
             , table_size(table_size)
-            , table_index(0)
+            , table_index(table_index)
             , bucket_iter{}
             , bucket_end{}
         {
@@ -427,6 +545,46 @@ public:
     iterator begin() { return iterator(mBuckets, mBucketCount); }
     iterator end() { return iterator(); }
 
+    /**
+     * Returns an iterator over all pairs in the buckets [first, last).
+     * It compares equal to end() after the last pair of that range. This
+     * allows for splitting iterations across threads.
+     */
+    iterator begin(const size_type first, const size_type last)
+    {
+        return iterator(mBuckets, std::min(last, buckets()), first);
+    }
+
+    /**
+     * Calls f on every pair that would be in the given bucket of a table
+     * with the given number of buckets (a slice).
+     *
+     * Unlike bucket positions, slices are stable across resizing as long as
+     * both sizes are reachable by regular growth (see fit), because one of
+     * them divides the other. Visiting all slices of the same count visits
+     * every pair exactly once, even if the table is resized in between.
+     */
+    template <class F>
+    void for_each_in_slice(const size_type slice, const size_type slices, F&& f)
+    {
+        if (!mBuckets)
+            return;
+
+        const auto numBuckets = mBucketCount.get_ro();
+        if (numBuckets >= slices) {
+            // The slice was split across every slices-th bucket
+            for (size_type i = slice; i < numBuckets; i += slices)
+                for (auto& elem : mBuckets[i])
+                    f(elem);
+        }
+        else {
+            // The slice was merged with others into a single bucket
+            for (auto& elem : mBuckets[slice % numBuckets])
+                if (hash(elem->key.get_ro(), slices) == slice)
+                    f(elem);
+        }
+    }
+
 // ############################################################################
 // PRIVATE API
 // ############################################################################
@@ -452,19 +610,52 @@ private:
      * Increases the size of the table by the given factor.
      */
     template <class pool_type>
-    void grow(const size_type factor, pmdk::pool<pool_type>& pool)
+    void grow(const size_type factor, pool_type& pool)
+    {
+        resize(factor * mBucketCount, pool);
+    }
+
+    /**
+     * Contracts the table after deletions. The new table is only filled up
+     * to half of the maximum load factor, so that the table does not grow
+     * again right after a few insertions.
+     */
+    template <class pool_type>
+    void shrink(pool_type& pool)
+    {
+        const auto target = fit(size(), Config::MAX_LOAD_FACTOR / 2);
+        if (target < mBucketCount.get_ro())
+            resize(target, pool);
+    }
+
+    /**
+     * Returns the smallest table size reachable by regular growth that
+     * holds the given number of elements without exceeding the given load.
+     */
+    static size_type fit(const size_type count, const float_type max_load)
+    {
+        size_type target = Config::INIT_SIZE;
+        while (static_cast<float_type>(count) / target > max_load)
+            target *= Config::GROW_FACTOR;
+        return target;
+    }
+
+    /**
+     * Replaces the table by one with the given number of buckets.
+     */
+    template <class pool_type>
+    void resize(const size_type bucket_count_new, pool_type& pool)
     {
-        pmdk::transaction::exec_tx(pool, [&,this](){
+        Backend::exec_tx(pool, [&,this](){
             // Create new table
-            const auto bucket_count_new = factor * mBucketCount;
             const auto buckets_new =
-                    pmdk::make_persistent<bucket_type[]>(bucket_count_new);
+                    Backend::template make_array<bucket_type>(bucket_count_new);
 
             // Hash all elements into the new table
             rehash_to_dest(buckets_new, bucket_count_new, pool);
 
             // Install new table and delete old one
-            pmdk::delete_persistent<bucket_type[]>(mBuckets, mBucketCount);
+            Backend::template destroy_array<bucket_type>(mBuckets, mBucketCount);
             mBuckets = buckets_new;
             mBucketCount.get_rw() = bucket_count_new;
         });
@@ -474,16 +665,17 @@ private:
      * Rehashes all elements from the current table into another table.
      */
     template <class pool_type>
-    void rehash_to_dest(pmdk::persistent_ptr<bucket_type[]> dest,
-                        const size_type dest_size, pmdk::pool<pool_type>& pool)
+    void rehash_to_dest(ptr<bucket_type[]> dest,
+                        const size_type dest_size, pool_type& pool)
     {
-        pmdk::transaction::exec_tx(pool, [&,this](){
+        Backend::exec_tx(pool, [&,this](){
             const auto numBuckets = mBucketCount.get_ro();
+            // Pairs are not moved, only their pointers are copied. The
+            // nodes of the old buckets are freed along with the old table.
             for (size_type i = 0; i < numBuckets; ++i) {
-                auto& bucket = mBuckets[i];
-                while (!bucket.empty()) {
-                    auto new_pos = hash(bucket.get(0)->key.get_ro(), dest_size);
-                    dest[new_pos].push_back_from(bucket, 0, pool);
+                for (auto& elem : mBuckets[i]) {
+                    auto new_pos = hash(elem->key.get_ro(), dest_size);
+                    dest[new_pos].push_back(elem, pool);
                 }
             }
         });
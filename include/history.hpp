@@ -1,35 +1,61 @@
 #ifndef MIDAS_HISTORY_HPP
 #define MIDAS_HISTORY_HPP
 
-#include <libpmemobj++/persistent_ptr.hpp>
-#include <libpmemobj++/mutex.hpp>
-#include <libpmemobj++/p.hpp>
-
 #include "types.hpp"
-#include "list.hpp"
+#include "backend.hpp"
+#include "chain.hpp"
 #include "version.hpp"
 
+#include <atomic>
+#include <cstdint>
+
 namespace midas {
 namespace detail {
 
 namespace pmdk = pmem::obj;
 
-struct History {
-    using ptr = pmdk::persistent_ptr<History>;
-    using elem_type = Version::ptr;
-
-    NVList<elem_type> chain;
-
-    // Synchronizes access to this history
-    // Reset on restart!
-    pmdk::mutex mutex;
-
-    History()
+template <class Backend>
+struct BasicHistory {
+    using ptr = typename Backend::template ptr<BasicHistory>;
+    using elem_type = typename BasicVersion<Backend>::ptr;
+
+    // Payloads up to this size are copied into the history. Chosen such
+    // that a history fills exactly one cache line.
+    static constexpr size_type INLINE_CAPACITY = 24;
+
+    // Versions from newest to oldest. Readers traverse it without locking.
+    BasicVersionChain<Backend> chain;
+
+    // Session in which this history was last recovered (lazy recovery only)
+    std::atomic<epoch_type> epoch;
+
+    // Copy of the newest committed version, so that most reads are served
+    // from this cache line alone (see Store::readInline). The copy is only
+    // valid while inlineVersion holds the offset of the chain head and
+    // inlineEpoch matches the current session. It is never recovered, only
+    // refilled by readers, so these fields are written without logging.
+    std::atomic<std::uint64_t> inlineVersion;
+    std::atomic<stamp_type> inlineBegin;
+    std::atomic<std::uint32_t> inlineEpoch;
+    std::atomic<std::uint32_t> inlineSize;
+    char inlineData[INLINE_CAPACITY];
+
+    explicit BasicHistory(const epoch_type epoch = 0)
         : chain{}
-        , mutex{}
+        , epoch{epoch}
+        , inlineVersion{0}
+        , inlineBegin{0}
+        , inlineEpoch{0}
+        , inlineSize{0}
+        , inlineData{}
     {}
 };
 
+using History = BasicHistory<PersistentBackend>;
+
+static_assert(sizeof(History) == LineAllocClass::SIZE,
+        "a history must fill exactly one cache line");
+
 } // end namespace detail
 } // end namespace midas
 
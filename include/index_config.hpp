@@ -4,6 +4,7 @@
 #include <string> // std::string
 
 #include "types.hpp"
+#include "hash.hpp"
 #include "hashmap.hpp"
 #include "string.hpp"
 
@@ -15,13 +16,19 @@ namespace pmdk = pmem::obj;
 // ############################################################################
 // Controls how volatile keys are mapped to persistent keys append ensures that
 // both key types produce the same hashes (required for rehashing)
+//
+// The actual hash function is a byte hash policy (see hash.hpp). Both key
+// types are hashed by the same policy over the same bytes, so they always
+// agree on the bucket of a key.
 // ############################################################################
 
-class IndexHasher {
+template <class KeyHash, class Backend = PersistentBackend>
+class BasicIndexHasher {
 public:
     using volatile_key_type = std::string;
-    using persistent_key_type = NVString;
+    using persistent_key_type = BasicNVString<Backend>;
     using result_type = std::size_t;
+    using key_hash_type = KeyHash;
 
     static result_type hash(const volatile_key_type& key) {
         return _hash(key.data(), key.size());
@@ -33,16 +40,14 @@ public:
 
 private:
     static result_type _hash(const char* str, result_type size) {
-        // size_type hash = seed;
-        result_type hash = 0;
-        for (result_type i=0; i<size; ++i)
-        {
-            hash = hash * 101 + *str++;
-        }
-        return hash;
+        return static_cast<result_type>(key_hash_type::hash(str, size));
     }
 };
 
+// Changing this type (or its seed) makes existing pools unreadable!
+using IndexKeyHash = StrideHash<>;
+using IndexHasher = BasicIndexHasher<IndexKeyHash>;
+
 // ############################################################################
 // Several parameters that control the behaviour of the hashmap (optional)
 // ############################################################################
@@ -54,6 +59,7 @@ struct IndexParams {
     static constexpr size_type INIT_SIZE = 4;
     static constexpr size_type GROW_FACTOR = 2;
     static constexpr float_type MAX_LOAD_FACTOR = 0.75;
+    static constexpr float_type MIN_LOAD_FACTOR = 0.25;
 };
 
 } // end namespace detail
@@ -0,0 +1,103 @@
+#ifndef MIDAS_LOCK_TABLE_HPP
+#define MIDAS_LOCK_TABLE_HPP
+
+#include <cstdint> // std::uint64_t
+#include <mutex>   // std::mutex
+#include <vector>  // std::vector
+
+#include "types.hpp"
+
+namespace midas {
+namespace detail {
+
+/**
+ * A fixed number of volatile mutexes that are shared by all persistent
+ * objects of a pool. An object is mapped to a stripe by its pool offset,
+ * so no lock state is kept in persistent memory and nothing needs to be
+ * reset after a restart.
+ *
+ * Unrelated objects may share a stripe. Hence, a thread must never hold
+ * more than one stripe at a time, otherwise it may deadlock with itself.
+ */
+class LockTable
+{
+// ############################################################################
+// TYPES
+// ############################################################################
+
+public:
+    using this_type = LockTable;
+    using offset_type = std::uint64_t;
+
+private:
+    // One stripe per cache line, so neighbouring stripes do not contend
+    struct alignas(64) stripe {
+        std::mutex mutex;
+    };
+
+// ############################################################################
+// MEMBER VARIABLES
+// ############################################################################
+
+private:
+    std::vector<stripe> mStripes;
+    offset_type mMask;
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+public:
+    /**
+     * Creates a table with the given number of stripes rounded up to
+     * the next power of two.
+     */
+    explicit LockTable(size_type count)
+        : mStripes(roundUp(count))
+        , mMask{mStripes.size() - 1}
+    {}
+
+    // Lock tables are neither copied nor moved
+    LockTable(const this_type& other) = delete;
+    this_type& operator=(const this_type& other) = delete;
+
+    /**
+     * Returns the mutex that guards the object at the given pool offset.
+     */
+    std::mutex& get(const offset_type offset)
+    {
+        return mStripes[spread(offset) & mMask].mutex;
+    }
+
+    size_type size() const { return mStripes.size(); }
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+private:
+    /**
+     * Objects are allocated at aligned offsets, so the low bits carry
+     * little information. Multiplying with a large odd constant and taking
+     * the high bits spreads consecutive allocations across all stripes.
+     */
+    static offset_type spread(const offset_type offset)
+    {
+        const auto h = offset * 0x9e3779b97f4a7c15ULL;
+        return h ^ (h >> 32);
+    }
+
+    static size_type roundUp(const size_type count)
+    {
+        size_type n = 1;
+        while (n < count)
+            n <<= 1;
+        return n;
+    }
+
+}; // end class LockTable
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
@@ -2,14 +2,30 @@
 #define MIDAS_HPP
 
 #include "store.hpp"
+#include "replication.hpp"
+#include "sharded_store.hpp"
 
 namespace midas {
 
     using detail::init;
     using detail::Store;
+    using detail::VolatileStore;
+    using detail::EmulatedStore;
+    using detail::StoreConfig;
     using detail::Transaction;
+    using detail::MediaProfile;
+    using detail::MediaEmulator;
+    using detail::LogShipper;
+    using detail::Replica;
+    using detail::VolatileLogShipper;
+    using detail::VolatileReplica;
+    using detail::ShardedStore;
+    using detail::VolatileShardedStore;
+    namespace media = detail::media;
 
     using pop_type = detail::Store::pool_type;
+    using volatile_pop_type = detail::VolatileStore::pool_type;
+    using emulated_pop_type = detail::EmulatedStore::pool_type;
 }
 
 #endif
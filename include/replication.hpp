@@ -0,0 +1,260 @@
+#ifndef MIDAS_REPLICATION_HPP
+#define MIDAS_REPLICATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "store.hpp"
+
+namespace midas {
+namespace detail {
+
+// ############################################################################
+// Log shipping
+//
+// A leader store ships the records of its change log (see
+// Store::readChanges) over a Unix domain socket to replicas. A replica
+// applies each record as a transaction of its own store, in the order of
+// the leader's commits, so its readers always see a state the leader went
+// through. Replicas are read-only and may lag behind the leader.
+//
+// A replica connects and sends the position in the leader's log it wants
+// to continue from (u64). The leader then sends frames of
+//
+//   header   frame type (u32), number of records (u32), position of the
+//            first record (u64), end of the leader's log (u64) and the
+//            time the frame was sent (u64, nanoseconds since the epoch)
+//   records  size (u32) and bytes of each record
+//
+// Heartbeats are frames without records that are sent while the leader is
+// idle. All numbers are in host byte order, as both ends share a host.
+// ############################################################################
+
+struct ReplicationFrame {
+    enum : std::uint32_t {
+        RECORDS = 1,
+        HEARTBEAT,
+
+        // The log has discarded records the replica still needs
+        TRUNCATED
+    };
+
+    std::uint32_t type;
+    std::uint32_t count;
+    std::uint64_t position;
+    std::uint64_t leaderEnd;
+    std::uint64_t sentAt;
+};
+
+/**
+ * Serves the change log of a store to replicas. Every replica is served by
+ * a thread of its own. The store needs a change log (see
+ * StoreConfig::changeLogSize) that is large enough to bridge the time
+ * replicas are behind or disconnected.
+ */
+template <class StoreType>
+class BasicLogShipper
+{
+// ############################################################################
+// TYPES
+// ############################################################################
+
+public:
+    using store_type = StoreType;
+    using position_type = typename store_type::position_type;
+
+    // Records per frame at most
+    static constexpr size_type FRAME_RECORDS = 256;
+
+    // Interval of heartbeats while there is nothing to ship
+    static constexpr std::chrono::milliseconds HEARTBEAT_INTERVAL{100};
+
+private:
+    // A connected replica. Guarded by session_mutex, except for the thread.
+    struct session {
+        int socket;
+        bool done;
+        std::thread thread;
+    };
+
+// ############################################################################
+// MEMBER VARIABLES
+// ############################################################################
+
+private:
+    store_type& store;
+    std::string path;
+    int listener;
+    std::atomic<bool> running;
+    std::thread acceptor;
+    std::list<session> sessions;
+    std::mutex session_mutex;
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+public:
+    explicit BasicLogShipper(store_type& store);
+    ~BasicLogShipper();
+
+    BasicLogShipper(const BasicLogShipper& other) = delete;
+    BasicLogShipper& operator=(const BasicLogShipper& other) = delete;
+
+    /**
+     * Starts to accept replicas on a socket at the given path, which must
+     * not exist yet. Fails with IO_ERROR if the socket cannot be set up.
+     */
+    int start(const std::string& socketPath);
+
+    /**
+     * Disconnects all replicas and removes the socket. Called by the
+     * destructor, so the store must outlive the shipper.
+     */
+    void stop();
+
+    // Number of connected replicas
+    size_type replicas();
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+private:
+    void accept();
+    void serve(session& s);
+};
+
+/**
+ * Keeps a store up to date with a leader served by a LogShipper and runs
+ * read-only transactions on it.
+ *
+ * The store must not be written to by anyone else. Its position in the
+ * leader's log (see Store::replicatedPosition) is durable, so a replica
+ * picks up where it left off after a restart. An empty store starts from
+ * the beginning of the log unless it was seeded first (see README).
+ */
+template <class StoreType>
+class BasicReplica
+{
+// ############################################################################
+// TYPES
+// ############################################################################
+
+public:
+    using store_type = StoreType;
+    using position_type = typename store_type::position_type;
+    using key_type = typename store_type::key_type;
+    using mapped_type = typename store_type::mapped_type;
+    using tx_ptr = typename store_type::tx_ptr;
+    using ChangeRecord = typename store_type::ChangeRecord;
+
+    // How far the replica is behind the leader
+    struct Lag {
+        position_type applied;     // position up to which records are applied
+        position_type leaderEnd;   // newest known end of the leader's log
+        size_type bytes;           // leaderEnd - applied
+        double seconds;            // age of the newest leader state the
+                                   // replica is known to reflect (negative
+                                   // before the first frame arrived)
+    };
+
+// ############################################################################
+// MEMBER VARIABLES
+// ############################################################################
+
+private:
+    store_type& store;
+    int socket;
+    std::atomic<bool> running;
+    std::atomic<int> mStatus;
+    std::thread applier;
+
+    // Progress of the applier. Guarded by lag_mutex.
+    position_type applied;
+    position_type leaderEnd;
+    std::uint64_t currentAt;
+    std::mutex lag_mutex;
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+public:
+    explicit BasicReplica(store_type& store);
+    ~BasicReplica();
+
+    BasicReplica(const BasicReplica& other) = delete;
+    BasicReplica& operator=(const BasicReplica& other) = delete;
+
+    /**
+     * Connects to the leader behind the given socket and starts to apply
+     * its records in the background. Fails with IO_ERROR if the leader
+     * cannot be reached.
+     *
+     * Each record is made durable before the next one is applied, so the
+     * store should use synchronous durability. After a crash, at most the
+     * last record is applied once more, which leaves the same state.
+     */
+    int connect(const std::string& socketPath);
+
+    /**
+     * Stops applying records and closes the connection. Called by the
+     * destructor.
+     */
+    void disconnect();
+
+    /**
+     * Returns OK while the replica is connected or was disconnected on
+     * purpose, IO_ERROR if the connection was lost and LOG_TRUNCATED if
+     * the leader no longer has the records the replica needs (or they were
+     * too large for its log). The last case requires seeding anew.
+     */
+    int status() const { return mStatus.load(); }
+
+    Lag lag();
+
+    /**
+     * Read-only transactions, see Store. Each one reads from a state the
+     * leader had after one of its commits.
+     */
+    tx_ptr begin() { return store.begin(); }
+    int read(tx_ptr tx, const key_type& key, mapped_type& result)
+    {
+        return store.read(tx, key, result);
+    }
+    int multiRead(tx_ptr tx, const std::vector<key_type>& keys,
+            std::vector<mapped_type>& results)
+    {
+        return store.multiRead(tx, keys, results);
+    }
+    int commit(tx_ptr tx) { return store.commit(tx); }
+    int abort(tx_ptr tx, int reason) { return store.abort(tx, reason); }
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+private:
+    void run();
+    int apply(const ChangeRecord& record, stamp_type& commitStamp);
+};
+
+using LogShipper = BasicLogShipper<Store>;
+using VolatileLogShipper = BasicLogShipper<VolatileStore>;
+using EmulatedLogShipper = BasicLogShipper<EmulatedStore>;
+
+using Replica = BasicReplica<Store>;
+using VolatileReplica = BasicReplica<VolatileStore>;
+using EmulatedReplica = BasicReplica<EmulatedStore>;
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef MIDAS_SHARDED_STORE_HPP
+#define MIDAS_SHARDED_STORE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "store.hpp"
+#include "hash.hpp"
+
+namespace midas {
+namespace detail {
+
+/**
+ * Spreads keys by hash over several stores (shards), each in a pool of its
+ * own, so that commits in different shards share no timestamp counter,
+ * transaction table or pool.
+ *
+ * A transaction begins in a shard when it first touches a key there.
+ * Transactions that touched a single shard commit there directly. Others
+ * commit in two phases: every shard validates its part and makes it
+ * durable without making it visible (see Store::prepare). If all succeed,
+ * the decision is recorded durably in one of them and all parts are
+ * committed, otherwise all are aborted. Shards share no snapshot, so reads
+ * are validated in every shard, which keeps transactions serializable.
+ *
+ * Shards must always be opened together (and in the same order), so that
+ * commits that were interrupted by a crash are completed or rolled back
+ * in all of them.
+ */
+template <class StoreType>
+class BasicShardedStore
+{
+// ############################################################################
+// TYPES
+// ############################################################################
+
+public:
+    using store_type = StoreType;
+    using pool_type = typename store_type::pool_type;
+    using key_type = typename store_type::key_type;
+    using mapped_type = typename store_type::mapped_type;
+    using store_tx_ptr = typename store_type::tx_ptr;
+
+    struct Transaction {
+        // Transaction in each shard, null while the shard was not touched
+        std::vector<store_tx_ptr> parts;
+        bool active;
+    };
+
+    using tx_ptr = std::shared_ptr<Transaction>;
+
+    // Independent of the hash that spreads keys over the buckets of a shard
+    using shard_hash = StrideHash<0x7368617264ULL>;
+
+// ############################################################################
+// MEMBER VARIABLES
+// ############################################################################
+
+private:
+    std::vector<std::unique_ptr<store_type>> stores;
+
+    // Ids of commits that span several shards
+    std::atomic<std::uint64_t> nextId;
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+public:
+    /**
+     * Opens a shard in each of the given pools with the given options.
+     * Commits that span several shards and were interrupted are completed
+     * if they were decided to commit and rolled back otherwise.
+     */
+    explicit BasicShardedStore(const std::vector<pool_type*>& pools,
+            const StoreConfig& config = StoreConfig{});
+
+    BasicShardedStore(const BasicShardedStore& other) = delete;
+    BasicShardedStore& operator=(const BasicShardedStore& other) = delete;
+
+    size_type shards() const { return stores.size(); }
+    store_type& shard(const size_type index) { return *stores[index]; }
+
+    // Index of the shard that holds the given key
+    size_type shardOf(const key_type& key) const
+    {
+        return shard_hash::hash(key.data(), key.size()) % stores.size();
+    }
+
+    /**
+     * Transactions as in Store. Any failure aborts the transaction in all
+     * shards it touched.
+     */
+    tx_ptr begin();
+    int abort(tx_ptr tx, int reason);
+    int commit(tx_ptr tx);
+
+    int read(tx_ptr tx, const key_type& key, mapped_type& result);
+    int write(tx_ptr tx, const key_type& key, const mapped_type& value);
+    int drop(tx_ptr tx, const key_type& key);
+    int upsert(tx_ptr tx, const key_type& key, const mapped_type& value);
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+private:
+    /**
+     * Returns the part of tx in the given shard, beginning it if needed.
+     */
+    store_tx_ptr& part(const tx_ptr& tx, size_type shard);
+
+    /**
+     * Aborts all parts of tx and returns the given status.
+     */
+    int fail(const tx_ptr& tx, int status);
+
+    /**
+     * Commits tx in several shards at once (see above).
+     */
+    int commitShards(const tx_ptr& tx);
+};
+
+using ShardedStore = BasicShardedStore<Store>;
+using VolatileShardedStore = BasicShardedStore<VolatileStore>;
+using EmulatedShardedStore = BasicShardedStore<EmulatedStore>;
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
@@ -0,0 +1,368 @@
+#ifndef MIDAS_SNAPSHOT_FILE_HPP
+#define MIDAS_SNAPSHOT_FILE_HPP
+
+#include <cstddef>  // std::size_t, std::ptrdiff_t
+#include <cstdint>  // std::uint32_t, std::uint64_t
+#include <cstdio>   // std::FILE, std::fopen
+#include <cstring>  // std::memcmp
+#include <iterator> // std::input_iterator_tag
+#include <memory>   // std::shared_ptr, std::unique_ptr
+#include <string>   // std::string
+#include <utility>  // std::pair
+#include <vector>   // std::vector
+
+#include <unistd.h> // fsync
+
+#include "hash.hpp"
+
+namespace midas {
+namespace detail {
+
+// ############################################################################
+// Snapshot files
+//
+// A snapshot (see Store::exportSnapshot) is a directory of shard files that
+// are written and read independently. Each shard consists of
+//
+//   header   magic, format version, shard number, shard count, timestamp
+//            of the snapshot and number of index slices it was taken with
+//   records  key size (u32), value size (u32), key bytes, value bytes
+//   trailer  END marker (u32), number of records (u64), checksum (u64)
+//
+// All numbers are in host byte order. The checksum covers every record in
+// order, so lost, altered or reordered records are detected.
+// ############################################################################
+
+struct SnapshotHeader {
+    static constexpr char MAGIC[8] = {'M', 'I', 'D', 'A', 'S', 'S', 'N', 'P'};
+    static constexpr std::uint32_t FORMAT = 1;
+
+    char magic[8];
+    std::uint32_t format;
+    std::uint32_t shard;
+    std::uint32_t shards;
+    std::uint32_t reserved;
+    std::uint64_t stamp;
+    std::uint64_t slices;
+};
+
+/**
+ * Order-dependent checksum over the records of a shard. Keys and values
+ * are hashed in strides (see StrideHash), so it keeps up with disks.
+ */
+class SnapshotChecksum
+{
+private:
+    using hash_type = StrideHash<0x6d69646173ULL>;
+    static constexpr std::uint64_t PRIME = 0x100000001b3ULL;
+
+    std::uint64_t state = 0xcbf29ce484222325ULL;
+
+public:
+    void add(const std::string& key, const std::string& value)
+    {
+        state = (state ^ hash_type::hash(key.data(), key.size())) * PRIME;
+        state = (state ^ hash_type::hash(value.data(), value.size())) * PRIME;
+    }
+
+    std::uint64_t value() const { return state; }
+};
+
+// Path of the given shard inside a snapshot directory
+inline std::string snapshotShardPath(const std::string& dir, const std::size_t shard)
+{
+    char name[48];
+    std::snprintf(name, sizeof(name), "/shard-%04zu.snap", shard);
+    return dir + name;
+}
+
+/**
+ * Writes a single shard. Output is buffered in large blocks and the file
+ * only appears under its final name once it is complete and synced.
+ */
+class SnapshotWriter
+{
+private:
+    static constexpr std::size_t BUFFER_SIZE = 1 << 20;
+    static constexpr std::uint32_t END = 0xffffffff;
+
+    std::string path;
+    std::string tmpPath;
+    std::FILE* file;
+    std::unique_ptr<char[]> buffer;
+    std::uint64_t count;
+    std::uint64_t bytes;
+    SnapshotChecksum checksum;
+    bool failed;
+
+public:
+    explicit SnapshotWriter(const std::string& path)
+        : path{path}
+        , tmpPath{path + ".tmp"}
+        , file{std::fopen(tmpPath.c_str(), "wb")}
+        , buffer{new char[BUFFER_SIZE]}
+        , count{0}
+        , bytes{0}
+        , checksum{}
+        , failed{file == nullptr}
+    {
+        if (file)
+            std::setvbuf(file, buffer.get(), _IOFBF, BUFFER_SIZE);
+    }
+
+    SnapshotWriter(const SnapshotWriter& other) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter& other) = delete;
+
+    ~SnapshotWriter()
+    {
+        if (file) {
+            std::fclose(file);
+            std::remove(tmpPath.c_str());
+        }
+    }
+
+    void writeHeader(const SnapshotHeader& header)
+    {
+        write(&header, sizeof(header));
+    }
+
+    void append(const std::string& key, const std::string& value)
+    {
+        const std::uint32_t sizes[2] = {
+            static_cast<std::uint32_t>(key.size()),
+            static_cast<std::uint32_t>(value.size())
+        };
+        write(sizes, sizeof(sizes));
+        write(key.data(), key.size());
+        write(value.data(), value.size());
+        checksum.add(key, value);
+        ++count;
+    }
+
+    /**
+     * Writes the trailer, syncs the file and moves it to its final name.
+     * Returns false if anything failed on the way.
+     */
+    bool finish()
+    {
+        const std::uint64_t trailer[2] = {count, checksum.value()};
+        write(&END, sizeof(END));
+        write(trailer, sizeof(trailer));
+        if (failed)
+            return false;
+
+        failed = std::fflush(file) != 0 || fsync(fileno(file)) != 0;
+        failed = std::fclose(file) != 0 || failed;
+        file = nullptr;
+        if (failed || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::uint64_t records() const { return count; }
+    std::uint64_t size() const { return bytes; }
+
+private:
+    void write(const void* data, const std::size_t size)
+    {
+        if (!failed && size)
+            failed = std::fwrite(data, size, 1, file) != 1;
+        bytes += size;
+    }
+};
+
+/**
+ * Reads a single shard record by record. The shard is only known to be
+ * intact once next() returned false and valid() returns true.
+ */
+class SnapshotReader
+{
+public:
+    using value_type = std::pair<std::string, std::string>;
+
+private:
+    static constexpr std::size_t BUFFER_SIZE = 1 << 20;
+    static constexpr std::uint32_t END = 0xffffffff;
+
+    std::FILE* file;
+    std::unique_ptr<char[]> buffer;
+    SnapshotHeader mHeader;
+    value_type mCurrent;
+    std::uint64_t count;
+    std::uint64_t bytes;
+    std::uint64_t fileSize;
+    SnapshotChecksum checksum;
+    bool failed;
+    bool complete;
+
+public:
+    explicit SnapshotReader(const std::string& path)
+        : file{std::fopen(path.c_str(), "rb")}
+        , buffer{new char[BUFFER_SIZE]}
+        , mHeader{}
+        , mCurrent{}
+        , count{0}
+        , bytes{0}
+        , fileSize{0}
+        , checksum{}
+        , failed{file == nullptr}
+        , complete{false}
+    {
+        if (file) {
+            std::setvbuf(file, buffer.get(), _IOFBF, BUFFER_SIZE);
+            std::fseek(file, 0, SEEK_END);
+            fileSize = std::ftell(file);
+            std::rewind(file);
+        }
+        read(&mHeader, sizeof(mHeader));
+        failed = failed ||
+            std::memcmp(mHeader.magic, SnapshotHeader::MAGIC, sizeof(mHeader.magic)) != 0 ||
+            mHeader.format != SnapshotHeader::FORMAT ||
+            mHeader.shard >= mHeader.shards;
+    }
+
+    SnapshotReader(const SnapshotReader& other) = delete;
+    SnapshotReader& operator=(const SnapshotReader& other) = delete;
+
+    ~SnapshotReader()
+    {
+        if (file)
+            std::fclose(file);
+    }
+
+    const SnapshotHeader& header() const { return mHeader; }
+
+    // Tests whether nothing went wrong so far (e.g. the header is intact)
+    bool good() const { return !failed; }
+
+    /**
+     * Reads the next record. Returns false at the end of the shard or if it
+     * cannot be read.
+     */
+    bool next()
+    {
+        if (failed || complete)
+            return false;
+
+        std::uint32_t keySize = 0;
+        read(&keySize, sizeof(keySize));
+        if (keySize == END) {
+            std::uint64_t trailer[2] = {};
+            read(trailer, sizeof(trailer));
+            complete = !failed && trailer[0] == count &&
+                trailer[1] == checksum.value() && std::fgetc(file) == EOF;
+            failed = !complete;
+            return false;
+        }
+
+        std::uint32_t valueSize = 0;
+        read(&valueSize, sizeof(valueSize));
+
+        // Damaged sizes must not turn into huge allocations
+        failed = failed || bytes + keySize + valueSize > fileSize;
+        if (failed)
+            return false;
+        mCurrent.first.resize(keySize);
+        mCurrent.second.resize(valueSize);
+        read(&mCurrent.first[0], keySize);
+        read(&mCurrent.second[0], valueSize);
+        if (failed)
+            return false;
+
+        checksum.add(mCurrent.first, mCurrent.second);
+        ++count;
+        return true;
+    }
+
+    const value_type& current() const { return mCurrent; }
+
+    // Tests whether the whole shard was read and matched its trailer
+    bool valid() const { return complete; }
+
+    std::uint64_t records() const { return count; }
+    std::uint64_t size() const { return bytes; }
+
+private:
+    void read(void* data, const std::size_t size)
+    {
+        if (!failed && size)
+            failed = std::fread(data, size, 1, file) != 1;
+        bytes += size;
+    }
+};
+
+/**
+ * Input iterator over the records of several shards in a row, as needed by
+ * Store::bulkLoad. It ends early if a shard cannot be read (see failed()).
+ */
+class SnapshotIterator
+{
+private:
+    struct state {
+        std::vector<std::string> paths;
+        std::size_t next;
+        std::unique_ptr<SnapshotReader> reader;
+        bool failed;
+    };
+
+    std::shared_ptr<state> mState;
+
+public:
+    using value_type = SnapshotReader::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    using iterator_category = std::input_iterator_tag;
+
+    // The end of every iteration
+    SnapshotIterator() : mState{} {}
+
+    explicit SnapshotIterator(const std::vector<std::string>& paths)
+        : mState{std::make_shared<state>(state{paths, 0, nullptr, false})}
+    {
+        advance();
+    }
+
+    reference operator*() const { return mState->reader->current(); }
+    pointer operator->() const { return &mState->reader->current(); }
+
+    SnapshotIterator& operator++()
+    {
+        advance();
+        return *this;
+    }
+
+    bool operator==(const SnapshotIterator& other) const
+    {
+        return (atEnd() && other.atEnd()) || mState == other.mState;
+    }
+
+    bool operator!=(const SnapshotIterator& other) const { return !(*this == other); }
+
+    bool failed() const { return mState && mState->failed; }
+
+private:
+    bool atEnd() const { return !mState || !mState->reader; }
+
+    void advance()
+    {
+        auto& s = *mState;
+        while (s.reader || s.next < s.paths.size()) {
+            if (!s.reader)
+                s.reader.reset(new SnapshotReader(s.paths[s.next++]));
+            if (s.reader->next())
+                return;
+            s.failed = s.failed || !s.reader->valid();
+            s.reader.reset();
+            if (s.failed)
+                s.next = s.paths.size();
+        }
+    }
+};
+
+} // end namespace detail
+} // end namespace midas
+
+#endif
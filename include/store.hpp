@@ -3,40 +3,198 @@
 
 #include <string>
 #include <mutex>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <set>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+#include <atomic>
 
 #include <libpmemobj++/pool.hpp>
 #include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pexceptions.hpp>
 
 #include <libcuckoo/cuckoohash_map.hh>
 
 #include "types.hpp"
 #include "index_config.hpp"
 #include "history.hpp"
+#include "lock_table.hpp"
 #include "tx.hpp"
+#include "backend.hpp"
+#include "snapshot_file.hpp"
+#include "change_log.hpp"
 
 namespace midas {
 namespace detail {
 
 namespace pmdk = pmem::obj;
 
-class Store
+// ############################################################################
+// Runtime options of a store
+// ############################################################################
+
+struct StoreConfig {
+    enum class Recovery {
+        // All histories are recovered before the store is constructed
+        Eager,
+
+        // Each history is recovered when it is accessed for the first time
+        Lazy
+    };
+
+    Recovery recovery = Recovery::Eager;
+
+    enum class Durability {
+        // Commits are durable when commit() returns
+        Sync,
+
+        // Commits are visible when commit() returns and become durable in the
+        // background, in the order they committed (see Store::waitDurable)
+        Async
+    };
+
+    Durability durability = Durability::Sync;
+
+    // Finalize commits (see Store::finalize) on a background thread instead
+    // of before commit() returns. This does not affect durability. Always on
+    // with asynchronous durability.
+    bool backgroundFinalize = true;
+
+    // Number of commits that may wait for the background thread before
+    // commit() waits as well. Also bounds the number of commits that are
+    // persisted at the same time.
+    size_type maxPendingCommits = 4096;
+
+    // Size in bytes of the change log in the pool (see Store::readChanges).
+    // Zero disables the log and frees an existing one. The log is written
+    // on the background thread, so it turns on backgroundFinalize.
+    size_type changeLogSize = 0;
+
+    // Number of threads that recover the index on startup (eager only).
+    // Zero selects one thread per hardware thread.
+    size_type recoveryThreads = 0;
+
+    // Recover untouched histories on a background thread (lazy only)
+    bool backgroundRecovery = false;
+
+    // Number of volatile locks shared by all histories (rounded up to a
+    // power of two). More locks mean fewer collisions between unrelated keys.
+    size_type historyLocks = 1024;
+
+    // Step by which pools with directory parts (see init) are extended when
+    // they run full. Zero keeps the default of PMDK (128 MB).
+    size_type growthStep = 0;
+
+    // Fraction of the pool capacity that must remain free. Commits that would
+    // eat into it fail with OUT_OF_SPACE (zero disables the check).
+    double minHeadroom = 0;
+
+    // Allocate versions, histories and index nodes from allocation classes
+    // of their own (see AllocClass). Applies to the pool of the store.
+    bool allocClasses = true;
+
+    // Decides on startup whether a commit that was prepared with the given
+    // id (see Store::prepare) and was neither committed nor aborted when the
+    // store went down is committed. Without it, such commits are rolled back.
+    // Set by ShardedStore, which also turns on the decision table.
+    std::function<bool(std::uint64_t)> resolvePrepared;
+};
+
+/**
+ * The storage engine. All persistent data lives in memory provided by the
+ * given backend (see backend.hpp): PersistentBackend for a PMDK pool
+ * (Store), VolatileBackend for the heap (VolatileStore) and EmulatedBackend
+ * for a PMDK pool with the latencies of another device (EmulatedStore).
+ */
+template <class Backend>
+class BasicStore
 {
 // ############################################################################
 // TYPES
 // ############################################################################
 
 public:
-    using this_type = Store;
+    using this_type = BasicStore<Backend>;
+    using backend_type = Backend;
     using key_type = std::string;
     using mapped_type = std::string;
 
-    using tx_table_type = cuckoohash_map<id_type, Transaction::ptr>;
-    using index_type = NVHashmap<IndexHasher, History::ptr, IndexParams>;
+    using Version = BasicVersion<Backend>;
+    using History = BasicHistory<Backend>;
+    using Transaction = BasicTransaction<Backend>;
+    using version_ptr = typename Version::ptr;
+    using history_ptr = typename History::ptr;
+    using tx_ptr = typename Transaction::ptr;
+
+    using tx_table_type = cuckoohash_map<id_type, tx_ptr>;
+    using index_type = NVHashmap<BasicIndexHasher<IndexKeyHash, Backend>, history_ptr,
+            IndexParams, Backend>;
+    using retired_list_type = NVChunkList<history_ptr, Backend>;
+    using change_log_type = NVChangeLog<Backend>;
+    using position_type = typename change_log_type::position_type;
+
+    template <class T> using ptr = typename Backend::template ptr<T>;
+    template <class T> using p = typename Backend::template p<T>;
+
+    // Trace of a commit that is not finalized yet (see persist and
+    // recoverCommits). Recovery finalizes it if end is set. Otherwise, the
+    // commit was not durable, and recovery frees the new versions that did
+    // not make it into their chains. Free if count is zero.
+    struct commit_slot {
+        p<stamp_type> end;
+        p<size_type> count;
+
+        // New and replaced version of each change (either may be null)
+        ptr<version_ptr[]> versions;
+
+        // History of each change (null for removals)
+        ptr<history_ptr[]> histories;
+
+        // Record for the change log (if enabled, see encodeChanges)
+        ptr<char[]> change;
+        p<size_type> changeSize;
+
+        // Id of a prepared commit that is not decided yet (zero otherwise)
+        p<std::uint64_t> prepared;
+    };
 
     struct root {
-        pmdk::persistent_ptr<index_type> index;
+        ptr<index_type> index;
+
+        // Number of the current session, incremented on every startup
+        p<epoch_type> epoch;
+
+        // Upper bound of all timestamps handed out so far
+        p<stamp_type> stampLimit;
+
+        // Histories removed from the index but not yet freed
+        ptr<retired_list_type> retired;
+
+        // Size the pool may grow to (set by init)
+        p<size_type> capacity;
+
+        // Traces of durable commits that are not finalized yet
+        ptr<commit_slot[]> commits;
+        p<size_type> commitCount;
+
+        // Write sets of past commits (if enabled)
+        ptr<change_log_type> changeLog;
+
+        // Position in the change log of a leader up to which this store
+        // replicates it (see Replica)
+        p<position_type> replicated;
+
+        // Ids of commits prepared in other stores that were decided to
+        // commit, until they are committed everywhere (see recordDecision)
+        ptr<std::uint64_t[]> decisions;
+        p<size_type> decisionCount;
     };
-    using pool_type = pmdk::pool<root>;
+    using pool_type = typename Backend::template pool<root>;
 
     // Status codes of API calls
     enum {
@@ -45,6 +203,10 @@ public:
         // KEY_EXISTS,
         RW_CONFLICT,
         WW_CONFLICT,
+        BUSY,
+        OUT_OF_SPACE,
+        IO_ERROR,
+        LOG_TRUNCATED,
         VALUE_NOT_FOUND = 404
     };
 
@@ -53,10 +215,72 @@ public:
         TS_INFINITY = std::numeric_limits<stamp_type>::max() - 1,
         TS_DELTA = 2,
         TS_START = 2,
+        TS_RESERVE = 1 << 20,
         ID_START = 1,
         TS_ZERO = 0
     };
 
+    // Number of pairs installed per persistent transaction in bulkLoad()
+    static constexpr size_type BULK_BATCH_SIZE = 4096;
+
+    // Number of commits finalized per persistent transaction in the
+    // background
+    static constexpr size_type DURABLE_BATCH_SIZE = 256;
+
+    // Pause in milliseconds before the background thread retries a commit
+    // that it failed to finalize. Doubled on every failure up to the limit.
+    static constexpr size_type FINALIZE_RETRY_DELAY = 1;
+    static constexpr size_type FINALIZE_RETRY_LIMIT = 1000;
+
+    // Number of index slices copied per lock of the index in snapshotScan()
+    static constexpr size_type SCAN_BATCH_SIZE = 64;
+
+    // Receives the pairs of a snapshot scan
+    using scan_callback = std::function<void(const key_type&, const mapped_type&)>;
+
+    // Outcome of a bulk load
+    struct LoadReport {
+        size_type keys;  // number of pairs loaded
+        double seconds;  // wall-clock duration of the load
+
+        double keysPerSecond() const { return seconds > 0 ? keys / seconds : 0; }
+    };
+
+    // A commit as recorded in the change log (see readChanges)
+    struct ChangeRecord {
+        using Kind = typename Transaction::Mod::Kind;
+
+        struct Change {
+            Kind kind;
+            key_type key;
+            mapped_type value;  // empty for removals
+        };
+
+        stamp_type stamp;  // end timestamp of the commit
+        bool complete;     // false if the changes were too large for the log
+        std::vector<Change> changes;
+    };
+
+    // Outcome of a snapshot export or import
+    struct SnapshotReport {
+        size_type keys;          // number of pairs written or loaded
+        size_type bytes;         // size of all shard files
+        double seconds;          // wall-clock duration
+        position_type position;  // change log end reflected by an export
+
+        double bytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0; }
+    };
+
+    // Space consumption of the pool
+    struct SpaceReport {
+        size_type capacity;   // size the pool may grow to (zero if unknown)
+        size_type allocated;  // bytes held by persistent objects
+
+        double headroom() const {
+            return capacity > allocated ? double(capacity - allocated) / capacity : 0;
+        }
+    };
+
 // ############################################################################
 // MEMBER VARIABLES
 // ############################################################################
@@ -75,33 +299,319 @@ private:
     // Logical clock for handing out timestamps. Must be even.
     std::atomic<stamp_type> timestampCounter;
 
+    // Volatile copy of root::stampLimit. Timestamps below this value may
+    // be handed out without touching persistent memory.
+    std::atomic<stamp_type> stampLimit;
+    std::mutex stamp_mutex;
+
     // Pool for handing out unique transaction identifiers. Must be odd.
     std::atomic<id_type> idCounter;
 
+    // Runtime options
+    const StoreConfig config;
+
+    // Volatile locks for histories, selected by their pool offset
+    LockTable historyLocks;
+
+    // Number of this session (see root::epoch)
+    epoch_type epoch;
+
+    // Volatile copy of root::capacity
+    size_type capacity;
+
+    // Recovers histories in the background (lazy recovery only)
+    std::thread sweeper;
+    std::atomic<bool> stopping;
+
+    // Histories that were removed from the index while running. Each one is
+    // freed once all transactions that were active at its removal (marked
+    // by the timestamp counter at that point) have finished. They are
+    // retired in the order of their stamps, and appended to the persistent
+    // list in the same order.
+    retired_list_type* retired;
+    std::deque<std::pair<stamp_type, history_ptr>> retiredHistories;
+    std::mutex retire_mutex;
+
+    // Begin timestamps of the transactions in tx_tab, so that the oldest one
+    // is known without locking the table (see getOldestActiveStamp)
+    std::multiset<stamp_type> activeStamps;
+    std::mutex active_mutex;
+
+    // Snapshots of running scans and the keys of obsolete histories that
+    // stay in the index until the scans that can see them have finished.
+    // Guarded by retire_mutex.
+    std::multiset<stamp_type> scanStamps;
+    std::vector<key_type> pinnedKeys;
+
+    // Commits that are visible but not yet finalized, in the order they
+    // became visible, with their slots (if any). End timestamps of commits
+    // that are not yet durable (asynchronous durability only).
+    std::deque<std::pair<tx_ptr, commit_slot*>> pendingCommits;
+    std::multiset<stamp_type> pendingStamps;
+    std::mutex durable_mutex;
+    std::condition_variable durableChanged;
+    std::thread finalizer;
+    std::atomic<int> finalizeError;
+
+    // Volatile copy of root::commits and the slots that are not in use
+    commit_slot* commitSlots;
+    std::vector<size_type> freeSlots;
+
+    // Slots of prepared commits by transaction id, and the entries of
+    // root::decisions that are not in use. Guarded by durable_mutex.
+    std::unordered_map<id_type, commit_slot*> preparedSlots;
+    std::atomic<size_type> numPrepared;
+    std::uint64_t* decisionTable;
+    std::vector<size_type> freeDecisions;
+
+    // Set while bulkLoad() runs, which holds load_mutex meanwhile.
+    // Transactions that begin during a load wait for it (see begin).
+    std::atomic<bool> loading;
+    std::mutex load_mutex;
+
+    // Volatile copy of root::changeLog (null if disabled) and the range of
+    // positions that readers may access
+    change_log_type* changeLog;
+    position_type logBegin;
+    position_type logEnd;
+    std::mutex log_mutex;
+    std::condition_variable logChanged;
+
 // ############################################################################
 // PUBLIC API
 // ############################################################################
 
 public:
-    explicit Store(pool_type& pop);
+    explicit BasicStore(pool_type& pop, const StoreConfig& config = StoreConfig{});
 
     // Copying is not allowed
-    explicit Store(const this_type& other) = delete;
+    explicit BasicStore(const this_type& other) = delete;
     this_type& operator=(const this_type& other) = delete;
 
     // Moving is not allowed
-    explicit Store(this_type&& other) = delete;
+    explicit BasicStore(this_type&& other) = delete;
     this_type& operator=(this_type&& other) = delete;
 
-    ~Store() = default;
+    ~BasicStore();
 
-    Transaction::ptr begin();
-    int abort(Transaction::ptr tx, int reason);
-    int commit(Transaction::ptr tx);
+    tx_ptr begin();
+    int abort(tx_ptr tx, int reason);
+    int commit(tx_ptr tx);
 
-    int read(Transaction::ptr tx, const key_type& key, mapped_type& result);
-    int write(Transaction::ptr tx, const key_type& key, const mapped_type& value);
-    int drop(Transaction::ptr tx, const key_type& key);
+    int read(tx_ptr tx, const key_type& key, mapped_type& result);
+
+    /**
+     * Reads several keys at once with the same semantics as read(). The
+     * i-th result belongs to the i-th key. Fails (and aborts tx) if any of
+     * the keys cannot be read.
+     *
+     * The index is locked once for all keys and every step of the lookups
+     * is done for all keys before the next one. This way, the memory
+     * accesses of different keys overlap instead of adding up.
+     */
+    int multiRead(tx_ptr tx, const std::vector<key_type>& keys,
+            std::vector<mapped_type>& results);
+    int write(tx_ptr tx, const key_type& key, const mapped_type& value);
+    int drop(tx_ptr tx, const key_type& key);
+
+    /**
+     * Writes a value without regard to previous values (blind write).
+     *
+     * As opposed to write(), only the newest version of the key is examined
+     * instead of scanning its history, so latency does not depend on the
+     * length of the history. If that version is owned by another active
+     * transaction or was committed after tx started, the write conflicts
+     * and tx is aborted with WW_CONFLICT.
+     */
+    int upsert(tx_ptr tx, const key_type& key, const mapped_type& value);
+
+    /**
+     * First phase of a commit that spans several stores (see ShardedStore).
+     * Validates tx like commit() does, but also its reads if it wrote nothing
+     * here, as the stores share no snapshot. Its changes are made durable
+     * under the given non-zero id without becoming visible. Afterwards, tx
+     * must be finished by commitPrepared() or abort().
+     *
+     * If the store goes down in between, StoreConfig::resolvePrepared decides
+     * on startup. Fails (and aborts tx) like commit().
+     */
+    int prepare(tx_ptr tx, std::uint64_t id);
+
+    /**
+     * Second phase: makes the changes of a prepared transaction visible.
+     * They are durable when this returns.
+     */
+    int commitPrepared(tx_ptr tx);
+
+    /**
+     * Records durably that the commit prepared under the given id is to be
+     * committed everywhere. Once it is, the returned entry is released by
+     * forgetDecision(). Requires StoreConfig::resolvePrepared.
+     */
+    size_type recordDecision(std::uint64_t id);
+    void forgetDecision(size_type entry);
+
+    /**
+     * Returns the decisions that are recorded in the pool of a store that is
+     * not open yet, and drops all of them (only while no decisions are made).
+     */
+    static std::vector<std::uint64_t> recordedDecisions(pool_type& pop);
+    void clearDecisions();
+
+    /**
+     * Writes several key-value pairs at once with the same semantics as
+     * write(). Fails (and aborts tx) if any of the pairs cannot be written.
+     *
+     * The index is locked once for all keys, versions are claimed in the
+     * order of their histories in the pool and all claims share a single
+     * persistent transaction.
+     */
+    int multiWrite(tx_ptr tx,
+            const std::vector<std::pair<key_type, mapped_type>>& pairs);
+
+    /**
+     * Loads a range of key-value pairs (e.g. from an initial data import).
+     *
+     * The index is presized for sizeHint additional keys and the pairs are
+     * installed in batches of BULK_BATCH_SIZE per persistent transaction.
+     * All pairs become visible at once to transactions that begin after
+     * the load. Existing keys are overwritten, later pairs in the range
+     * overwrite earlier ones with the same key.
+     *
+     * This bypasses concurrency control entirely. It fails with BUSY if any
+     * transaction is active. Transactions that begin during the load wait
+     * until it has finished. Commits that are not yet finalized are waited
+     * for.
+     * If the pool runs full, the load stops with OUT_OF_SPACE and all batches
+     * before the failed one remain loaded.
+     *
+     * The number of loaded keys and the load throughput are stored in the
+     * output parameter.
+     */
+    template <class InputIt>
+    int bulkLoad(InputIt first, InputIt last, size_type sizeHint, LoadReport& report);
+
+    /**
+     * Returns the durable watermark: every commit that has returned and whose
+     * end timestamp (see Transaction::getEnd) is not above the watermark is
+     * durable.
+     */
+    stamp_type durableStamp();
+
+    /**
+     * Waits until the commit with the given end timestamp and all commits
+     * that became visible before it are durable. Returns at once with
+     * synchronous durability.
+     */
+    void waitDurable(stamp_type commitStamp);
+
+    /**
+     * Returns OK unless the background thread currently fails to finalize
+     * commits, e.g. OUT_OF_SPACE if the pool is full. It keeps retrying
+     * meanwhile, so waitDurable() does not return before it succeeds.
+     */
+    int finalizeStatus() const;
+
+    /**
+     * Reports how much of the pool is in use. Callers may watch the headroom
+     * to add space (e.g. further parts of a poolset) before commits start
+     * failing with OUT_OF_SPACE.
+     */
+    SpaceReport space();
+
+    /**
+     * Passes every key with its value as of a single snapshot to the
+     * callback, using the given number of threads (including the caller).
+     * The callback is called concurrently and in no particular order.
+     *
+     * The snapshot is taken when the scan starts and stays consistent while
+     * transactions continue. The index is locked only for copying a few
+     * slices at a time (see SCAN_BATCH_SIZE), never while the callback runs.
+     * Histories that are retired during the scan (see retireHistory) stay
+     * in the index if the scan can still see one of their versions. All
+     * other histories are retired and freed as usual.
+     *
+     * If the callback throws, the scan stops and the first exception is
+     * rethrown on the calling thread.
+     */
+    int snapshotScan(const scan_callback& callback, size_type parallelism = 1);
+
+    /**
+     * Writes a snapshot (see snapshotScan) to the given directory, which is
+     * created if needed. The snapshot is split into one shard file per
+     * thread (see snapshot_file.hpp), each covering a contiguous range of
+     * index slices. Pairs are ordered by slice, i.e. by hash. Shards only
+     * appear once they are complete. Surplus shards of an earlier export to
+     * the same directory are removed.
+     *
+     * Fails with IO_ERROR if a shard cannot be written. The number of pairs,
+     * the size of the shards and the throughput are stored in the output
+     * parameter, along with the end of the change log when the snapshot was
+     * taken. All records before it are reflected by the snapshot, later ones
+     * may be in part (see README on seeding replicas).
+     */
+    int exportSnapshot(const std::string& dir, size_type threads = 1);
+    int exportSnapshot(const std::string& dir, size_type threads,
+            SnapshotReport& report);
+
+    /**
+     * Loads a snapshot that was written by exportSnapshot() through
+     * bulkLoad(), with the same restrictions. All shards are verified first
+     * (in parallel, with the given number of threads), so a damaged snapshot
+     * or one mixing shards of different exports fails with IO_ERROR before
+     * anything is loaded.
+     */
+    int importSnapshot(const std::string& dir, size_type threads = 1);
+    int importSnapshot(const std::string& dir, size_type threads,
+            SnapshotReport& report);
+
+    /**
+     * Reads up to maxRecords commits from the change log, starting at the
+     * given position, in the order in which they became visible, and moves
+     * the position past them. Commits show up in the log once they are
+     * finalized. Read-only commits are not recorded.
+     *
+     * Fails with LOG_TRUNCATED if the log has discarded records at the
+     * position already (see changeLogBegin). Nothing is read if the log is
+     * disabled (see StoreConfig::changeLogSize).
+     */
+    int readChanges(position_type& position, size_type maxRecords,
+            std::vector<ChangeRecord>& records);
+
+    /**
+     * Same as above, but returns the records as they are stored in the log
+     * (e.g. for shipping them to replicas, see LogShipper). Each record
+     * takes up change_log_type::footprint(record.size()) positions.
+     */
+    int readChanges(position_type& position, size_type maxRecords,
+            std::vector<std::string>& records);
+
+    /**
+     * Decodes a record as returned by the function above.
+     */
+    static void decodeChanges(const std::string& data, ChangeRecord& record);
+
+    /**
+     * Returns the position of the oldest and after the newest record in the
+     * change log. Positions keep growing across restarts.
+     */
+    position_type changeLogBegin();
+    position_type changeLogEnd();
+
+    /**
+     * Waits until the change log holds records at or after the given
+     * position, but no longer than the given timeout. Returns false on
+     * timeout.
+     */
+    bool waitChanges(position_type position, std::chrono::milliseconds timeout);
+
+    /**
+     * Returns or sets the position in the change log of a leader up to
+     * which this store is a replica of it (zero initially). Setting it
+     * is durable right away, but not atomic with any transaction.
+     */
+    position_type replicatedPosition();
+    void setReplicatedPosition(position_type position);
 
     void print();
 
@@ -112,35 +622,348 @@ public:
 private:
 
     void init();
-    void purgeHistory(History::ptr& history);
+    void recoverBuckets(size_type first, size_type last,
+            std::vector<key_type>& emptied);
+    void recoverHistory(history_ptr& history);
+    void sweep();
 
-    int insert(Transaction::ptr tx, const key_type& key, const mapped_type& value);
-    Version::ptr getWritableSnapshot(History::ptr& history, Transaction::ptr tx);
-    Version::ptr getReadableSnapshot(History::ptr& history, Transaction::ptr tx);
-    bool isWritable(Version::ptr& v, Transaction::ptr tx);
-    bool isReadable(Version::ptr& v, Transaction::ptr tx);
-    int validate(Transaction::ptr tx);
-    void rollback(Transaction::ptr tx);
-    void finalize(Transaction::ptr tx);
-    int persist(Transaction::ptr tx);
+    /**
+     * Tests whether commits are finalized on a background thread.
+     */
+    bool deferFinalize() const;
+
+    /**
+     * Tests whether a commit is traced by its slot once it is visible, i.e.
+     * durable right away (see persist). Prepared commits always are.
+     */
+    bool isTraced(std::uint64_t prepared) const;
+
+    /**
+     * Finalizes the commits traced in slots of the previous session and
+     * sizes the slots for this session.
+     */
+    void recoverCommits();
+
+    /**
+     * Opens, creates, resizes or frees the change log as configured.
+     */
+    void initChangeLog();
+
+    /**
+     * Allocates the decision table if needed (see recordDecision). Entries
+     * from before the restart are kept until clearDecisions().
+     */
+    void initDecisions();
+
+    /**
+     * Returns the record of tx for the change log (empty if tx changed
+     * nothing).
+     */
+    std::string encodeChanges(const tx_ptr& tx);
+
+    /**
+     * Appends the given records to the change log in one persistent
+     * transaction, along with anything done by f. Records that would be
+     * discarded by later ones right away are skipped.
+     */
+    template <class F>
+    void logChanges(const std::vector<std::string>& records, F&& f);
+
+    /**
+     * Returns a free commit slot, waiting for one if needed.
+     */
+    commit_slot* claimSlot();
+    void releaseSlot(commit_slot* slot);
+
+    /**
+     * Frees what a slot traces and marks it as unused. Must be called
+     * inside a persistent transaction.
+     */
+    void clearSlot(commit_slot& slot);
+
+    /**
+     * Returns the slot of a prepared transaction (or null) and forgets it.
+     */
+    commit_slot* takePreparedSlot(const tx_ptr& tx);
+
+    /**
+     * Makes tx visible and queues it for finalize() on the background.
+     */
+    void queueCommit(tx_ptr tx, commit_slot* slot);
+
+    /**
+     * Finalizes queued commits in batches until the store is destroyed
+     * and the queue is empty. Runs on a thread of its own.
+     */
+    void finalizeCommits();
+
+    /**
+     * Forgets a finalized transaction and retires the histories it removed.
+     */
+    void completeCommit(tx_ptr tx);
+    bool needsRepair(const history_ptr& history);
+
+    /**
+     * Removes the history of the given key from the index if none of its
+     * versions can become visible or writable again.
+     */
+    void retireHistory(const key_type& key);
+
+    /**
+     * Frees retired histories that are no longer accessible.
+     */
+    void reclaimHistories();
+
+    /**
+     * Adds a transaction to tx_tab and removes it again.
+     */
+    void addTransaction(const tx_ptr& tx);
+    void removeTransaction(const tx_ptr& tx);
+
+    /**
+     * Returns the begin timestamp of the oldest active transaction or the
+     * next timestamp if there is none.
+     */
+    stamp_type getOldestActiveStamp();
+
+    /**
+     * Tests whether a running scan can see a version of the given history.
+     * Callers must hold retire_mutex.
+     */
+    bool isPinned(const history_ptr& history);
+
+    /**
+     * Tests whether all versions of the given history are invalidated
+     * by committed transactions or belong to failed ones.
+     */
+    bool isObsolete(const history_ptr& history);
+    void purgeHistory(history_ptr& history);
+
+    /**
+     * Tests whether the changes of tx leave at least the configured headroom
+     * in the pool.
+     */
+    bool hasHeadroom(tx_ptr tx);
+
+    /**
+     * Makes transactions that begin from now on wait (see begin) and tests
+     * whether any transaction is active. If so, transactions are admitted
+     * again and false is returned.
+     */
+    bool blockTransactions();
+    void unblockTransactions();
+
+    using batch_type = std::vector<std::pair<key_type, mapped_type>>;
+    int loadBatch(const batch_type& batch, stamp_type stamp);
+
+    /**
+     * Takes a snapshot for a scan and registers it, so that histories it
+     * can see stay in the index (see retireHistory).
+     */
+    tx_ptr pinSnapshot();
+
+    /**
+     * Unregisters a snapshot and retires the histories kept for it.
+     */
+    void unpinSnapshot(const tx_ptr& snapshot);
+
+    /**
+     * Appends the pairs of the given index slices that are visible to the
+     * snapshot to the batch. Locks the index meanwhile.
+     */
+    void copySlices(const tx_ptr& snapshot, size_type first, size_type last,
+            size_type slices, batch_type& batch);
+
+    int insert(tx_ptr tx, const key_type& key, const mapped_type& value);
 
-    bool isValidTransaction(const Transaction::ptr tx);
+    /**
+     * Updates the change set entry of a key that was written before in tx.
+     * Returns false if there is no such entry.
+     */
+    bool rewriteChange(tx_ptr tx, const key_type& key,
+            const mapped_type& value);
+
+    /**
+     * Claims the writable version of the given history for tx (second half
+     * of write()). A null history means that the key does not exist yet.
+     */
+    int writeHistory(tx_ptr tx, const key_type& key,
+            history_ptr& history, const mapped_type& value,
+            bool abortOnFailure = true);
+    version_ptr getWritableSnapshot(history_ptr& history, tx_ptr tx);
+    version_ptr getReadableSnapshot(history_ptr& history, tx_ptr tx);
+
+    /**
+     * Returns the newest version of the given history, skipping versions
+     * of failed transactions, or nullptr if there is none.
+     */
+    version_ptr getNewestVersion(history_ptr& history);
+
+    /**
+     * Reads the version of the given history that is visible to tx and
+     * adds it to the read set (second half of read()).
+     */
+    int readHistory(tx_ptr tx, history_ptr& history, mapped_type& result);
+
+    /**
+     * Serves a read from the copy of the newest version inside the history.
+     * Returns false if the copy is missing, outdated or not visible to tx,
+     * in which case the chain must be scanned.
+     */
+    bool readInline(history_ptr& history, tx_ptr tx,
+            version_ptr& version, std::string& result);
+
+    /**
+     * Copies the given version into its history if it is the newest
+     * committed and valid version. Skipped if the history is busy.
+     */
+    void publishInline(history_ptr& history, version_ptr& v);
+
+    /**
+     * Invalidates the copy inside the history if it refers to the given
+     * version. Must follow every change to the end field of a version.
+     */
+    void clearInline(history_ptr& history, const version_ptr& v);
+    bool isWritable(version_ptr& v, tx_ptr tx);
+
+    /**
+     * Reads the begin and end field of a version along with the transactions
+     * whose ids they hold. Transactions leave the transaction table only
+     * after replacing their ids, so the fields are read again if one is gone.
+     */
+    void loadVersion(version_ptr& v, stamp_type& begin, stamp_type& end,
+            tx_ptr& beginTx, tx_ptr& endTx);
+    bool isReadable(version_ptr& v, tx_ptr tx);
+    int validate(tx_ptr tx);
+    int validateReads(tx_ptr tx);
+    void rollback(tx_ptr tx);
+    void finalize(tx_ptr tx);
+
+    /**
+     * Installs the new versions of tx and lists them in the given slot. If
+     * the commit is traced (see isTraced), it is durable once this returns,
+     * or prepared under the given id if that is non-zero.
+     */
+    int persist(tx_ptr tx, commit_slot* slot, std::uint64_t prepared = 0);
+
+    /**
+     * Hands out the next timestamp. Raises the persistent limit first if
+     * the timestamp is not covered by it.
+     */
+    stamp_type nextStamp();
+    void reserveStamps(stamp_type stamp);
+
+    bool isValidTransaction(const tx_ptr tx);
+
+    /**
+     * Claims a writable version for the given transaction by atomically
+     * replacing its end field with the transaction id. Returns false if
+     * another transaction claimed the version first.
+     */
+    bool tagVersion(history_ptr& history, version_ptr& v, tx_ptr tx);
 
     /**
      * Tests whether the given history contains at least one
      * version that is not permanently invalidated.
      */
-    bool hasValidSnapshots(const History::ptr& hist);
+    bool hasValidSnapshots(const history_ptr& hist);
+
+    /**
+     * Returns the end timestamp of the transaction with the given id if it
+     * has committed but is not finalized yet. Returns anything else as is.
+     */
+    stamp_type resolveStamp(stamp_type data);
 
     /**
      * Tests whether the given value is a transaction id.
      */
     inline bool isTransactionId(const stamp_type data);
-    Transaction::status_code getTransactionStatus(const id_type id);
+    typename Transaction::status_code getTransactionStatus(const id_type id);
 };
 
+using Store = BasicStore<PersistentBackend>;
+using VolatileStore = BasicStore<VolatileBackend>;
+using EmulatedStore = BasicStore<EmulatedBackend>;
+
+/**
+ * Opens the pool in the given file or creates it with the given size.
+ *
+ * The file may also be a poolset (see poolset(5) of PMDK) that spans
+ * several files or devices, in which case the size is given by its parts
+ * and pool_size is ignored. Parts that are directories are reservations:
+ * PMDK adds files to them whenever the pool runs full (see
+ * StoreConfig::growthStep), so the pool grows on demand up to the sum of
+ * all part sizes.
+ */
 bool init(Store::pool_type& pop, std::string file, size_type pool_size);
 
+/**
+ * Same as above for stores with emulated media latencies (see
+ * MediaEmulator). Pools can be used with both kinds of stores.
+ */
+bool init(EmulatedStore::pool_type& pop, std::string file, size_type pool_size);
+
+// ############################################################################
+// TEMPLATE MEMBER FUNCTIONS
+// ############################################################################
+
+template <class Backend>
+template <class InputIt>
+int BasicStore<Backend>::bulkLoad(InputIt first, InputIt last, size_type sizeHint,
+        LoadReport& report)
+{
+    const auto start = std::chrono::steady_clock::now();
+    report = LoadReport{0, 0};
+
+    // Reject if there is anyone who could observe a partial load, and keep
+    // everyone else out until the load is done
+    if (!blockTransactions())
+        return BUSY;
+
+    // All loaded versions look like they were committed by a single
+    // transaction that ended right now.
+    const auto stamp = nextStamp();
+
+    int status = OK;
+    try {
+        // Presize the index so that no rehashing happens during the load
+        index_mutex.lock();
+        try {
+            index->reserve(index->size() + sizeHint, pop);
+        }
+        catch (const pmem::transaction_alloc_error&) {
+            // Without presizing, the index is simply rehashed more often
+        }
+        index_mutex.unlock();
+
+        batch_type batch;
+        batch.reserve(BULK_BATCH_SIZE);
+        for (; first != last && status == OK; ++first) {
+            batch.emplace_back(first->first, first->second);
+            if (batch.size() == BULK_BATCH_SIZE) {
+                status = loadBatch(batch, stamp);
+                if (status == OK)
+                    report.keys += batch.size();
+                batch.clear();
+            }
+        }
+        if (!batch.empty()) {
+            status = loadBatch(batch, stamp);
+            if (status == OK)
+                report.keys += batch.size();
+        }
+    }
+    catch (...) {
+        unblockTransactions();
+        throw;
+    }
+    unblockTransactions();
+
+    const auto stop = std::chrono::steady_clock::now();
+    report.seconds = std::chrono::duration<double>(stop - start).count();
+    return status;
+}
+
 } // end namespace detail
 } // end namespace midas
 
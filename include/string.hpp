@@ -8,10 +8,7 @@
 #include <utility>   // std::swap
 #include <string>    // std::string
 
-#include <libpmemobj++/make_persistent_array.hpp>
-#include <libpmemobj++/make_persistent.hpp>
-#include <libpmemobj++/persistent_ptr.hpp>
-#include <libpmemobj++/p.hpp>
+#include "backend.hpp"
 
 namespace midas {
 namespace detail {
@@ -23,13 +20,14 @@ namespace pmdk = pmem::obj;
 // * terminate string with null-byte
 // * add more functions from std::string
 // * consider introducing a capacity to avoid needless allocations
-struct NVString
+template <class Backend>
+struct BasicNVString
 {
 // ############################################################################
 // TYPES
 // ############################################################################
 
-    using this_type = NVString;
+    using this_type = BasicNVString<Backend>;
     using size_type = std::size_t;
     using volatile_string = std::string;
 
@@ -37,14 +35,14 @@ struct NVString
 // MEMBER VARIABLES
 // ############################################################################
 
-    pmdk::persistent_ptr<char[]> data;
-    pmdk::p<size_type> size;
+    typename Backend::template ptr<char[]> data;
+    typename Backend::template p<size_type> size;
 
 // ############################################################################
 // CONSTRUCTORS
 // ############################################################################
 
-    NVString()
+    BasicNVString()
         : data{}
         , size{}
     {}
@@ -52,9 +50,9 @@ struct NVString
     // Copying is not allowed at the moment
     // One reason is that I really want to avoid all kinds of allocations.
     // By prohibiting copying, I get a compiler error whenever someone tries.
-    explicit NVString(const this_type& other) = delete;
+    explicit BasicNVString(const this_type& other) = delete;
 
-    explicit NVString(this_type&& other)
+    explicit BasicNVString(this_type&& other)
         : data{}
         , size{}
     {
@@ -76,9 +74,9 @@ struct NVString
         return *this;
     }
 
-    ~NVString()
+    ~BasicNVString()
     {
-        pmdk::delete_persistent<char[]>(data, size);
+        Backend::template destroy_array<char>(data, size);
     }
 
 // ############################################################################
@@ -159,8 +157,8 @@ struct NVString
     this_type& operator=(const volatile_string& other)
     {
         const auto otherSize = other.size();
-        pmdk::delete_persistent<char[]>(data, size);
-        data = pmdk::make_persistent<char[]>(otherSize);
+        Backend::template destroy_array<char>(data, size);
+        data = Backend::template make_array<char>(otherSize);
         for (size_type i=0; i<otherSize; ++i)
             data[i] = other[i];
         size.get_rw() = other.size();
@@ -168,7 +166,10 @@ struct NVString
     }
 };
 
-std::ostream& operator<<(std::ostream& os, const NVString& str);
+template <class Backend>
+std::ostream& operator<<(std::ostream& os, const BasicNVString<Backend>& str);
+
+using NVString = BasicNVString<PersistentBackend>;
 
 } // end namespace detail
 } // end namespace midas
@@ -12,12 +12,14 @@
 namespace midas {
 namespace detail {
 
-class Transaction {
+template <class Backend>
+class BasicTransaction {
 public:
-    using this_type = Transaction;
+    using this_type = BasicTransaction<Backend>;
     using key_type = std::string;
     using value_type = std::string;
     using ptr = std::shared_ptr<this_type>;
+    using version_ptr = typename BasicVersion<Backend>::ptr;
 
     struct Mod {
         enum class Kind {
@@ -27,13 +29,13 @@ public:
         };
 
         Kind            code;
-        Version::ptr    v_origin; // nullptr if code == Insert
+        version_ptr     v_origin; // nullptr if code == Insert
         value_type      delta;    // empty if code == Remove
-        Version::ptr    v_new;    // nullptr if code == Remove
+        version_ptr     v_new;    // nullptr if code == Remove
     };
 
     using write_set_t = std::unordered_map<key_type, Mod>;
-    using read_set_t = std::vector<Version::ptr>;
+    using read_set_t = std::vector<version_ptr>;
 
     enum status_code {
         ACTIVE,
@@ -52,7 +54,7 @@ private:
     read_set_t mReadSet;
 
 public:
-    Transaction(const id_type id, const stamp_type begin)
+    BasicTransaction(const id_type id, const stamp_type begin)
         : mId{id}
         , mBegin{begin}
         , mEnd{}
@@ -62,15 +64,15 @@ public:
     {}
 
     // Transactions cannot be copied
-    explicit Transaction(const this_type& other) = delete;
+    explicit BasicTransaction(const this_type& other) = delete;
     this_type& operator=(const this_type& other) = delete;
 
     // Transactions could be moved there is currently no need for that
-    explicit Transaction(this_type&& other) = delete;
+    explicit BasicTransaction(this_type&& other) = delete;
     this_type& operator=(this_type&& other) = delete;
 
     // Destruction is trivial
-    ~Transaction() = default;
+    ~BasicTransaction() = default;
 
     id_type getId() const { return mId; }
     stamp_type getBegin() const { return mBegin; }
@@ -87,6 +89,8 @@ public:
 
 }; // end class transaction
 
+using Transaction = BasicTransaction<PersistentBackend>;
+
 } // end namespace detail
 } // end namespace midas
 
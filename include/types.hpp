@@ -10,6 +10,7 @@ namespace detail {
     using size_type = std::size_t;
     using stamp_type = std::uint64_t;
     using id_type = stamp_type;
+    using epoch_type = std::uint64_t;
 
 } // end namespace detail
 } // end namespace midas
@@ -1,21 +1,22 @@
 #ifndef MIDAS_VERSION_HPP
 #define MIDAS_VERSION_HPP
 
-#include <libpmemobj++/persistent_ptr.hpp>
-#include <libpmemobj++/p.hpp>
-
 #include "types.hpp"
 #include "string.hpp"
+#include "alloc_class.hpp"
+#include "backend.hpp"
 
 #include <atomic>
+#include <cstdint>
 
 namespace midas {
 namespace detail {
 
 namespace pmdk = pmem::obj;
 
-struct Version {
-    using ptr = pmdk::persistent_ptr<Version>;
+template <class Backend>
+struct BasicVersion {
+    using ptr = typename Backend::template ptr<BasicVersion>;
 
     // timestamp from when this version was created (became visible)
     // TODO make atomic
@@ -27,15 +28,25 @@ struct Version {
     std::atomic<stamp_type> end;
 
     // payload of this version
-    NVString data;
+    BasicNVString<Backend> data;
+
+    // pool offset of the next older version in the same history (0 = none)
+    // see VersionChain
+    std::atomic<std::uint64_t> next;
 
-    Version()
+    BasicVersion()
         : begin{}
         , end{}
         , data{}
+        , next{0}
     {}
 };
 
+using Version = BasicVersion<PersistentBackend>;
+
+// Versions are created on every commit
+using VersionAllocClass = AllocClass<sizeof(Version), 200>;
+
 } // end namespace detail
 } // end namespace midas
 
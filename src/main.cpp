@@ -21,6 +21,7 @@ void usage()
 {
     std::cout << "Commands:\n\n";
     std::cout << "  w KEY VALUE     Inserts or updates the specified pair\n";
+    std::cout << "  u KEY VALUE     Same as w but without looking at older versions (blind write)\n";
     std::cout << "  r KEY           Retrieves the value associated with they key (if any)\n";
     std::cout << "  d KEY           Removes the pair with the given key (if any)\n";
     std::cout << "  p               Prints the database with complete histories\n";
@@ -30,9 +31,10 @@ void usage()
 void execCommand(midas::Store& store, const command& pack)
 {
     const auto [cmd, key, value] = pack;
-    if (cmd == "w" && key.size() && value.size()) {
+    if ((cmd == "w" || cmd == "u") && key.size() && value.size()) {
         auto tx = store.begin();
-        auto status = store.write(tx, key, value);
+        auto status = cmd == "w" ? store.write(tx, key, value)
+                                 : store.upsert(tx, key, value);
         if (status) {
             std::cout << RED << "write failed with status: ";
             std::cout << status << RESET << std::endl;
@@ -0,0 +1,457 @@
+#include "replication.hpp"
+
+#include <algorithm> // std::find, std::max
+#include <cerrno>    // errno
+#include <cstring>   // std::memcpy, std::strncpy
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace midas {
+namespace detail {
+
+// ############################################################################
+// Socket helpers
+// ############################################################################
+
+namespace {
+
+bool sendAll(const int socket, const void* data, std::size_t size)
+{
+    auto bytes = static_cast<const char*>(data);
+    while (size) {
+        const auto sent = ::send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool receiveAll(const int socket, void* data, std::size_t size)
+{
+    auto bytes = static_cast<char*>(data);
+    while (size) {
+        const auto received = ::recv(socket, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+bool makeAddress(const std::string& path, sockaddr_un& address)
+{
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return true;
+}
+
+std::uint64_t nanosSinceEpoch()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // end anonymous namespace
+
+// ############################################################################
+// LOG SHIPPER
+// ############################################################################
+
+template <class StoreType>
+constexpr size_type BasicLogShipper<StoreType>::FRAME_RECORDS;
+
+template <class StoreType>
+constexpr std::chrono::milliseconds BasicLogShipper<StoreType>::HEARTBEAT_INTERVAL;
+
+template <class StoreType>
+BasicLogShipper<StoreType>::BasicLogShipper(store_type& store)
+    : store{store}
+    , path{}
+    , listener{-1}
+    , running{false}
+    , acceptor{}
+    , sessions{}
+{}
+
+template <class StoreType>
+BasicLogShipper<StoreType>::~BasicLogShipper()
+{
+    stop();
+}
+
+template <class StoreType>
+int BasicLogShipper<StoreType>::start(const std::string& socketPath)
+{
+    if (running)
+        return store_type::OK;
+
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address))
+        return store_type::IO_ERROR;
+
+    listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return store_type::IO_ERROR;
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listener, SOMAXCONN) != 0) {
+        ::close(listener);
+        listener = -1;
+        return store_type::IO_ERROR;
+    }
+
+    path = socketPath;
+    running = true;
+    acceptor = std::thread(&BasicLogShipper::accept, this);
+    return store_type::OK;
+}
+
+template <class StoreType>
+void BasicLogShipper<StoreType>::stop()
+{
+    if (!running)
+        return;
+
+    // Shutting the listener down wakes up the acceptor
+    running = false;
+    ::shutdown(listener, SHUT_RDWR);
+    acceptor.join();
+    ::close(listener);
+    listener = -1;
+    ::unlink(path.c_str());
+
+    // Sessions notice within a heartbeat interval, or at once if they are
+    // blocked on their socket
+    session_mutex.lock();
+    for (auto& s : sessions) {
+        if (!s.done)
+            ::shutdown(s.socket, SHUT_RDWR);
+    }
+    session_mutex.unlock();
+    for (auto& s : sessions)
+        s.thread.join();
+    sessions.clear();
+}
+
+template <class StoreType>
+size_type BasicLogShipper<StoreType>::replicas()
+{
+    std::lock_guard<std::mutex> guard{session_mutex};
+    return std::count_if(sessions.begin(), sessions.end(),
+        [](const session& s){ return !s.done; });
+}
+
+template <class StoreType>
+void BasicLogShipper<StoreType>::accept()
+{
+    while (running) {
+        const auto socket = ::accept(listener, nullptr, nullptr);
+        if (socket < 0) {
+            if (running && errno == EINTR)
+                continue;
+            break;
+        }
+
+        std::lock_guard<std::mutex> guard{session_mutex};
+
+        // Sessions of replicas that went away are cleaned up lazily
+        for (auto it = sessions.begin(); it != sessions.end(); ) {
+            if (it->done) {
+                it->thread.join();
+                it = sessions.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        sessions.emplace_back();
+        auto& s = sessions.back();
+        s.socket = socket;
+        s.done = false;
+        s.thread = std::thread(&BasicLogShipper::serve, this, std::ref(s));
+    }
+}
+
+template <class StoreType>
+void BasicLogShipper<StoreType>::serve(session& s)
+{
+    position_type position;
+    bool connected = receiveAll(s.socket, &position, sizeof(position));
+
+    std::vector<std::string> records;
+    std::string frame;
+    while (connected && running) {
+        ReplicationFrame header{};
+        header.position = position;
+        const auto status = store.readChanges(position, FRAME_RECORDS, records);
+        if (status == store_type::LOG_TRUNCATED) {
+            header.type = ReplicationFrame::TRUNCATED;
+        }
+        else if (records.empty()) {
+            if (store.waitChanges(position, HEARTBEAT_INTERVAL))
+                continue;
+            header.type = ReplicationFrame::HEARTBEAT;
+        }
+        else {
+            header.type = ReplicationFrame::RECORDS;
+            header.count = static_cast<std::uint32_t>(records.size());
+        }
+        header.leaderEnd = std::max(store.changeLogEnd(), position);
+        header.sentAt = nanosSinceEpoch();
+
+        // Each frame goes out in a single piece
+        frame.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& record : records) {
+            const auto size = static_cast<std::uint32_t>(record.size());
+            frame.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            frame.append(record);
+        }
+        connected = sendAll(s.socket, frame.data(), frame.size()) &&
+            header.type != ReplicationFrame::TRUNCATED;
+    }
+
+    session_mutex.lock();
+    ::close(s.socket);
+    s.done = true;
+    session_mutex.unlock();
+}
+
+// ############################################################################
+// REPLICA
+// ############################################################################
+
+template <class StoreType>
+BasicReplica<StoreType>::BasicReplica(store_type& store)
+    : store{store}
+    , socket{-1}
+    , running{false}
+    , mStatus{store_type::OK}
+    , applier{}
+    , applied{store.replicatedPosition()}
+    , leaderEnd{applied}
+    , currentAt{0}
+{}
+
+template <class StoreType>
+BasicReplica<StoreType>::~BasicReplica()
+{
+    disconnect();
+}
+
+template <class StoreType>
+int BasicReplica<StoreType>::connect(const std::string& socketPath)
+{
+    if (running)
+        return store_type::OK;
+
+    // Clean up after a lost connection
+    disconnect();
+
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address))
+        return store_type::IO_ERROR;
+
+    socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket < 0)
+        return store_type::IO_ERROR;
+
+    // The leader continues from where this replica left off
+    const position_type position = store.replicatedPosition();
+    if (::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            !sendAll(socket, &position, sizeof(position))) {
+        ::close(socket);
+        socket = -1;
+        return store_type::IO_ERROR;
+    }
+
+    lag_mutex.lock();
+    applied = position;
+    leaderEnd = position;
+    lag_mutex.unlock();
+
+    mStatus = store_type::OK;
+    running = true;
+    applier = std::thread(&BasicReplica::run, this);
+    return store_type::OK;
+}
+
+template <class StoreType>
+void BasicReplica<StoreType>::disconnect()
+{
+    if (socket < 0)
+        return;
+
+    // Shutting the socket down wakes up the applier
+    running = false;
+    ::shutdown(socket, SHUT_RDWR);
+    applier.join();
+    ::close(socket);
+    socket = -1;
+}
+
+template <class StoreType>
+typename BasicReplica<StoreType>::Lag BasicReplica<StoreType>::lag()
+{
+    std::lock_guard<std::mutex> guard{lag_mutex};
+    Lag lag;
+    lag.applied = applied;
+    lag.leaderEnd = std::max(leaderEnd, applied);
+    lag.bytes = lag.leaderEnd - applied;
+    lag.seconds = currentAt
+        ? (static_cast<double>(nanosSinceEpoch()) - currentAt) / 1e9
+        : -1;
+    return lag;
+}
+
+template <class StoreType>
+void BasicReplica<StoreType>::run()
+{
+    using change_log_type = typename store_type::change_log_type;
+
+    auto position = store.replicatedPosition();
+    std::string data;
+    ChangeRecord record;
+    int status = store_type::OK;
+    while (status == store_type::OK) {
+        ReplicationFrame header;
+        if (!receiveAll(socket, &header, sizeof(header))) {
+            status = store_type::IO_ERROR;
+            break;
+        }
+
+        lag_mutex.lock();
+        leaderEnd = std::max<position_type>(leaderEnd, header.leaderEnd);
+        lag_mutex.unlock();
+
+        if (header.type == ReplicationFrame::TRUNCATED) {
+            status = store_type::LOG_TRUNCATED;
+            break;
+        }
+        if (header.position != position) {
+            status = store_type::IO_ERROR;
+            break;
+        }
+
+        for (std::uint32_t i = 0; i < header.count && status == store_type::OK; ++i) {
+            std::uint32_t size;
+            if (!receiveAll(socket, &size, sizeof(size))) {
+                status = store_type::IO_ERROR;
+                break;
+            }
+            data.resize(size);
+            if (size && !receiveAll(socket, &data[0], size)) {
+                status = store_type::IO_ERROR;
+                break;
+            }
+
+            // Records that did not fit into the leader's log lack changes
+            store_type::decodeChanges(data, record);
+            if (!record.complete) {
+                status = store_type::LOG_TRUNCATED;
+                break;
+            }
+
+            // The position must not get ahead of what is durable
+            stamp_type commitStamp = 0;
+            status = apply(record, commitStamp);
+            if (status != store_type::OK)
+                break;
+            if (commitStamp)
+                store.waitDurable(commitStamp);
+            position += change_log_type::footprint(size);
+            store.setReplicatedPosition(position);
+
+            lag_mutex.lock();
+            applied = position;
+            lag_mutex.unlock();
+        }
+
+        lag_mutex.lock();
+        if (status == store_type::OK && applied >= header.leaderEnd)
+            currentAt = header.sentAt;
+        lag_mutex.unlock();
+    }
+
+    // Failures after disconnect() are expected
+    if (running)
+        mStatus = status;
+    running = false;
+}
+
+template <class StoreType>
+int BasicReplica<StoreType>::apply(const ChangeRecord& record, stamp_type& commitStamp)
+{
+    if (record.changes.empty())
+        return store_type::OK;
+
+    // Removals of keys that are absent already (e.g. when a record is
+    // applied a second time) are left out on the next attempt
+    std::vector<key_type> absent;
+    for (;;) {
+        auto tx = store.begin();
+        int status = store_type::OK;
+        for (const auto& change : record.changes) {
+            if (change.kind == ChangeRecord::Kind::Remove) {
+                if (std::find(absent.begin(), absent.end(), change.key) != absent.end())
+                    continue;
+                status = store.drop(tx, change.key);
+                if (status == store_type::VALUE_NOT_FOUND)
+                    absent.push_back(change.key);
+            }
+            else {
+                status = store.upsert(tx, change.key, change.value);
+            }
+            if (status != store_type::OK)
+                break;
+        }
+
+        if (status == store_type::OK) {
+            status = store.commit(tx);
+            if (status == store_type::OK) {
+                commitStamp = tx->getEnd();
+                return status;
+            }
+        }
+        else {
+            // Only some failures abort the transaction by themselves
+            store.abort(tx, status);
+        }
+
+        // Conflicts can only come from commits of the replica itself that
+        // are still being finalized, so they go away on their own
+        switch (status) {
+            case store_type::VALUE_NOT_FOUND:
+                break;
+            case store_type::RW_CONFLICT:
+            case store_type::WW_CONFLICT:
+            case store_type::BUSY:
+                std::this_thread::yield();
+                break;
+            default:
+                return status;
+        }
+    }
+}
+
+template class BasicLogShipper<Store>;
+template class BasicLogShipper<VolatileStore>;
+template class BasicLogShipper<EmulatedStore>;
+
+template class BasicReplica<Store>;
+template class BasicReplica<VolatileStore>;
+template class BasicReplica<EmulatedStore>;
+
+} // end namespace detail
+} // end namespace midas
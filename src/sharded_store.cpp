@@ -0,0 +1,196 @@
+#include "sharded_store.hpp"
+
+#include <unordered_set> // std::unordered_set
+
+namespace midas {
+namespace detail {
+
+// ############################################################################
+// PUBLIC API
+// ############################################################################
+
+template <class StoreType>
+BasicShardedStore<StoreType>::BasicShardedStore(const std::vector<pool_type*>& pools,
+        const StoreConfig& config)
+    : stores{}
+    , nextId{1}
+{
+    // Shards recover one after another, so the decisions of all of them are
+    // collected first. Prepared commits of the previous session are settled
+    // on startup, so ids may start over.
+    auto decided = std::make_shared<std::unordered_set<std::uint64_t>>();
+    for (const auto pop : pools)
+        for (const auto id : store_type::recordedDecisions(*pop))
+            decided->insert(id);
+
+    auto shardConfig = config;
+    shardConfig.resolvePrepared = [decided](const std::uint64_t id){
+        return decided->count(id) > 0;
+    };
+    for (const auto pop : pools)
+        stores.emplace_back(new store_type{*pop, shardConfig});
+
+    // Only now have all shards settled their prepared commits
+    for (auto& store : stores)
+        store->clearDecisions();
+}
+
+template <class StoreType>
+typename BasicShardedStore<StoreType>::tx_ptr BasicShardedStore<StoreType>::begin()
+{
+    return std::make_shared<Transaction>(Transaction{
+        std::vector<store_tx_ptr>(stores.size()),
+        true
+    });
+}
+
+template <class StoreType>
+int BasicShardedStore<StoreType>::abort(tx_ptr tx, int reason)
+{
+    if (!tx || !tx->active)
+        return store_type::INVALID_TX;
+    return fail(tx, reason);
+}
+
+template <class StoreType>
+int BasicShardedStore<StoreType>::commit(tx_ptr tx)
+{
+    if (!tx || !tx->active)
+        return store_type::INVALID_TX;
+
+    size_type touched = 0;
+    size_type last = 0;
+    for (size_type i = 0; i < stores.size(); ++i) {
+        if (tx->parts[i]) {
+            ++touched;
+            last = i;
+        }
+    }
+
+    // Transactions within a single shard are as good as their shard's
+    tx->active = false;
+    if (touched == 0)
+        return store_type::OK;
+    if (touched == 1)
+        return stores[last]->commit(tx->parts[last]);
+    return commitShards(tx);
+}
+
+template <class StoreType>
+int BasicShardedStore<StoreType>::read(tx_ptr tx, const key_type& key, mapped_type& result)
+{
+    if (!tx || !tx->active)
+        return store_type::INVALID_TX;
+
+    const auto shard = shardOf(key);
+    const auto status = stores[shard]->read(part(tx, shard), key, result);
+    return status == store_type::OK ? status : fail(tx, status);
+}
+
+template <class StoreType>
+int BasicShardedStore<StoreType>::write(tx_ptr tx, const key_type& key,
+        const mapped_type& value)
+{
+    if (!tx || !tx->active)
+        return store_type::INVALID_TX;
+
+    const auto shard = shardOf(key);
+    const auto status = stores[shard]->write(part(tx, shard), key, value);
+    return status == store_type::OK ? status : fail(tx, status);
+}
+
+template <class StoreType>
+int BasicShardedStore<StoreType>::drop(tx_ptr tx, const key_type& key)
+{
+    if (!tx || !tx->active)
+        return store_type::INVALID_TX;
+
+    const auto shard = shardOf(key);
+    const auto status = stores[shard]->drop(part(tx, shard), key);
+    return status == store_type::OK ? status : fail(tx, status);
+}
+
+template <class StoreType>
+int BasicShardedStore<StoreType>::upsert(tx_ptr tx, const key_type& key,
+        const mapped_type& value)
+{
+    if (!tx || !tx->active)
+        return store_type::INVALID_TX;
+
+    const auto shard = shardOf(key);
+    const auto status = stores[shard]->upsert(part(tx, shard), key, value);
+    return status == store_type::OK ? status : fail(tx, status);
+}
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+template <class StoreType>
+typename BasicShardedStore<StoreType>::store_tx_ptr& BasicShardedStore<StoreType>::part(
+        const tx_ptr& tx, const size_type shard)
+{
+    auto& part = tx->parts[shard];
+    if (!part)
+        part = stores[shard]->begin();
+    return part;
+}
+
+template <class StoreType>
+int BasicShardedStore<StoreType>::fail(const tx_ptr& tx, const int status)
+{
+    // Parts that failed on their own are no longer valid, which is fine
+    for (size_type i = 0; i < stores.size(); ++i)
+        if (tx->parts[i])
+            stores[i]->abort(tx->parts[i], status);
+    tx->active = false;
+    return status;
+}
+
+template <class StoreType>
+int BasicShardedStore<StoreType>::commitShards(const tx_ptr& tx)
+{
+    std::vector<size_type> writers;
+    for (size_type i = 0; i < stores.size(); ++i)
+        if (tx->parts[i] && !tx->parts[i]->getChangeSet().empty())
+            writers.push_back(i);
+
+    // With a single writer, nothing has to be decided: its own commit does,
+    // after all other parts have been validated
+    const bool decide = writers.size() > 1;
+    const auto skip = decide || writers.empty() ? stores.size() : writers.front();
+
+    const auto id = nextId.fetch_add(1);
+    for (size_type i = 0; i < stores.size(); ++i) {
+        if (!tx->parts[i] || i == skip)
+            continue;
+        const auto status = stores[i]->prepare(tx->parts[i], id);
+        if (status != store_type::OK)
+            return fail(tx, status);
+    }
+
+    if (skip != stores.size()) {
+        const auto status = stores[skip]->commit(tx->parts[skip]);
+        if (status != store_type::OK)
+            return fail(tx, status);
+    }
+
+    // From here on, the commit survives a crash in every shard. The decision
+    // is kept until all parts are committed, which cannot fail anymore.
+    size_type entry = 0;
+    if (decide)
+        entry = stores[writers.front()]->recordDecision(id);
+    for (size_type i = 0; i < stores.size(); ++i)
+        if (tx->parts[i] && i != skip)
+            stores[i]->commitPrepared(tx->parts[i]);
+    if (decide)
+        stores[writers.front()]->forgetDecision(entry);
+    return store_type::OK;
+}
+
+template class BasicShardedStore<Store>;
+template class BasicShardedStore<VolatileStore>;
+template class BasicShardedStore<EmulatedStore>;
+
+} // end namespace detail
+} // end namespace midas
@@ -2,8 +2,13 @@
 
 #include <experimental/filesystem>  // std::exists
 #include <memory> // std::make_shared
-
-// #include <sstream>
+#include <thread> // std::thread
+#include <algorithm> // std::min, std::sort, std::fill, std::any_of
+#include <unordered_map> // std::unordered_map
+#include <fstream> // std::ifstream
+#include <sstream> // std::istringstream
+#include <exception> // std::exception_ptr
+#include <cstring> // std::memcpy
 
 namespace midas {
 namespace detail {
@@ -12,38 +17,129 @@ namespace detail {
 // PUBLIC API
 // ############################################################################
 
-Store::Store(pool_type& pop)
+template <class Backend>
+BasicStore<Backend>::BasicStore(pool_type& pop, const StoreConfig& config)
     : pop{pop}
     , index{}
     , tx_tab{}
     , timestampCounter{TS_START}
+    , stampLimit{TS_START}
     , idCounter{ID_START}
+    , config{config}
+    , historyLocks{config.historyLocks}
+    , epoch{}
+    , capacity{}
+    , sweeper{}
+    , stopping{false}
+    , retired{}
+    , retiredHistories{}
+    , activeStamps{}
+    , pendingCommits{}
+    , pendingStamps{}
+    , finalizer{}
+    , finalizeError{OK}
+    , commitSlots{}
+    , freeSlots{}
+    , preparedSlots{}
+    , numPrepared{0}
+    , decisionTable{}
+    , freeDecisions{}
+    , loading{false}
+    , changeLog{}
+    , logBegin{0}
+    , logEnd{0}
 {
     init();
 }
 
-Transaction::ptr Store::begin()
+template <class Backend>
+BasicStore<Backend>::~BasicStore()
 {
-    // Create new transaction with current timestamp
-    auto tx = std::make_shared<Transaction>(
-        idCounter.fetch_add(TS_DELTA),
-        timestampCounter.fetch_add(TS_DELTA)
-    );
-
-    if (!tx)
-        return nullptr;
-
-    // Add new transaction to list of running transactions
-    tx_tab.insert(tx->getId(), tx);
+    // Pending commits are made durable before the finalizer stops
+    durable_mutex.lock();
+    stopping.store(true);
+    durable_mutex.unlock();
+    durableChanged.notify_all();
+    if (finalizer.joinable())
+        finalizer.join();
+    if (sweeper.joinable())
+        sweeper.join();
+
+    // The pool may be closed from now on (see AllocClass::enable)
+    if constexpr (Backend::PERSISTENT) {
+        VersionAllocClass::enable(pop.handle(), false);
+        LineAllocClass::enable(pop.handle(), false);
+    }
 
-    // std::cout << "Store::begin(): spawned new transaction {";
-    // std::cout << "id=" << tx->getId() << ", begin=" << tx->getBegin() << "}\n";
-    // std::cout << "Store::begin(): number of transactions is " << tx_tab.size() << '\n';
+    // Nothing survives a volatile pool, so everything is freed right away
+    if constexpr (!Backend::PERSISTENT) {
+        auto root = pop.get_root();
+        Backend::exec_tx(pop, [&,this](){
+            for (auto it = index->begin(); it != index->end(); ++it)
+                Backend::template destroy<History>((*it)->value);
+            index->clear(pop);
+            Backend::template destroy<index_type>(root->index);
+            root->index = nullptr;
+
+            for (auto& hist : *retired)
+                Backend::template destroy<History>(hist);
+            Backend::template destroy<retired_list_type>(root->retired);
+            root->retired = nullptr;
+
+            if (root->commits)
+                Backend::template destroy_array<commit_slot>(root->commits,
+                        root->commitCount.get_ro());
+            root->commits = nullptr;
+            root->commitCount = 0;
+
+            if (root->changeLog)
+                Backend::template destroy<change_log_type>(root->changeLog);
+            root->changeLog = nullptr;
+
+            if (root->decisions)
+                Backend::template destroy_array<std::uint64_t>(root->decisions,
+                        root->decisionCount.get_ro());
+            root->decisions = nullptr;
+            root->decisionCount = 0;
+        });
+    }
+}
 
-    return tx;
+template <class Backend>
+typename BasicStore<Backend>::tx_ptr BasicStore<Backend>::begin()
+{
+    for (;;) {
+        // Create new transaction with current timestamp
+        auto tx = std::make_shared<Transaction>(
+            idCounter.fetch_add(TS_DELTA),
+            nextStamp()
+        );
+
+        if (!tx)
+            return nullptr;
+
+        // Add new transaction to list of running transactions
+        addTransaction(tx);
+
+        // std::cout << "Store::begin(): spawned new transaction {";
+        // std::cout << "id=" << tx->getId() << ", begin=" << tx->getBegin() << "}\n";
+        // std::cout << "Store::begin(): number of transactions is " << tx_tab.size() << '\n';
+
+        // A bulk load either finds tx in the table and gives up, or we see
+        // the load here (see blockTransactions). In that case, we wait for
+        // it and begin anew, so that tx sees all of the load.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!loading.load())
+            return tx;
+
+        removeTransaction(tx);
+        load_mutex.lock();
+        load_mutex.unlock();
+    }
 }
 
-int Store::abort(Transaction::ptr tx, int reason)
+template <class Backend>
+int BasicStore<Backend>::abort(tx_ptr tx, int reason)
 {
     // std::cout << "Store::abort(tx{id=" << tx->getId() << "}";
     // std::cout << ", reason=" << reason << "):" << '\n';
@@ -61,13 +157,30 @@ int Store::abort(Transaction::ptr tx, int reason)
     // Undo all changes carried out by tx
     rollback(tx);
 
-    tx_tab.erase(tx->getId());
+    // A prepared commit is no longer traced. Should the store go down
+    // before, it is rolled back anyway, as it was not decided.
+    if (auto slot = takePreparedSlot(tx)) {
+        Backend::exec_tx(pop, [&,this](){
+            clearSlot(*slot);
+        });
+        releaseSlot(slot);
+    }
+
+    removeTransaction(tx);
+
+    // Histories that were created for our inserts hold nothing but
+    // rolled back versions now, if any (see persist)
+    for (const auto& [key, change] : tx->getChangeSet())
+        if (change.code == Transaction::Mod::Kind::Insert)
+            retireHistory(key);
+    reclaimHistories();
 
     // return the specified error code (supplied by the caller)
     return reason;
 }
 
-int Store::commit(Transaction::ptr tx)
+template <class Backend>
+int BasicStore<Backend>::commit(tx_ptr tx)
 {
     // std::cout << "Store::commit(tx{id=" << tx->getId() << "}):" << '\n';
 
@@ -76,15 +189,34 @@ int Store::commit(Transaction::ptr tx)
         return INVALID_TX;
 
     // Set tx end timestamp
-    tx->setEnd(timestampCounter.fetch_add(TS_DELTA));
+    tx->setEnd(nextStamp());
 
     auto status = validate(tx);
     if (status != OK)
         return abort(tx, status);
 
-    status = persist(tx);
-    if (status != OK)
+    if (!hasHeadroom(tx))
+        return abort(tx, OUT_OF_SPACE);
+
+    // Commits are listed in a slot while they are persisted. With synchronous
+    // durability, the slot traces them afterwards, so that they are durable
+    // without being finalized.
+    commit_slot* slot = nullptr;
+    if (!tx->getChangeSet().empty())
+        slot = claimSlot();
+
+    status = persist(tx, slot);
+    if (status != OK) {
+        releaseSlot(slot);
         return abort(tx, status);
+    }
+
+    // Finalizing is left to the background if enabled. Until then, tx stays
+    // in the transaction table, so its versions resolve through its status.
+    if (deferFinalize()) {
+        queueCommit(tx, slot);
+        return OK;
+    }
 
     // Mark tx as committed.
     // This must be done atomically because operations of concurrent
@@ -93,16 +225,87 @@ int Store::commit(Transaction::ptr tx)
     tx->getStatus().store(Transaction::COMMITTED);
 
     // Propagate end timestamp of tx to end/begin fields of original/new versions
-    finalize(tx);
+    Backend::exec_tx(pop, [&,this](){
+        finalize(tx);
+        if (slot)
+            clearSlot(*slot);
+    });
+    releaseSlot(slot);
+    completeCommit(tx);
+    return OK;
+}
 
-    // Now that all its modifications have become persistent, we can safely
-    // remove this transaction from our list
-    tx_tab.erase(tx->getId());
+template <class Backend>
+int BasicStore<Backend>::prepare(tx_ptr tx, const std::uint64_t id)
+{
+    if (!isValidTransaction(tx))
+        return INVALID_TX;
 
+    tx->setEnd(nextStamp());
+    auto status = validateReads(tx);
+    if (status != OK)
+        return abort(tx, status);
+
+    // Nothing to make durable
+    if (tx->getChangeSet().empty())
+        return OK;
+
+    if (!hasHeadroom(tx))
+        return abort(tx, OUT_OF_SPACE);
+
+    // The versions keep our id, so they stay invisible to others and
+    // conflict with their writes until the commit is decided
+    auto slot = claimSlot();
+    status = persist(tx, slot, id);
+    if (status != OK) {
+        releaseSlot(slot);
+        return abort(tx, status);
+    }
+
+    durable_mutex.lock();
+    preparedSlots.emplace(tx->getId(), slot);
+    ++numPrepared;
+    durable_mutex.unlock();
     return OK;
 }
 
-int Store::read(Transaction::ptr tx, const key_type& key, mapped_type& result)
+template <class Backend>
+int BasicStore<Backend>::commitPrepared(tx_ptr tx)
+{
+    if (!isValidTransaction(tx))
+        return INVALID_TX;
+
+    auto slot = takePreparedSlot(tx);
+    if (!slot)
+        return commit(tx);
+
+    // Snapshots taken since the prepare must not see the changes, as they
+    // were not visible then
+    tx->setEnd(nextStamp());
+
+    // Once the slot no longer carries the id, the commit survives a crash
+    // without a decision
+    if (deferFinalize()) {
+        Backend::exec_tx(pop, [&,this](){
+            slot->end = tx->getEnd();
+            slot->prepared = 0;
+        });
+        queueCommit(tx, slot);
+        return OK;
+    }
+
+    tx->getStatus().store(Transaction::COMMITTED);
+    Backend::exec_tx(pop, [&,this](){
+        finalize(tx);
+        clearSlot(*slot);
+    });
+    releaseSlot(slot);
+    completeCommit(tx);
+    return OK;
+}
+
+template <class Backend>
+int BasicStore<Backend>::read(tx_ptr tx, const key_type& key, mapped_type& result)
 {
     // std::cout << "Store::read(tx{id=" << tx->getId() << "}):" << '\n';
 
@@ -112,22 +315,75 @@ int Store::read(Transaction::ptr tx, const key_type& key, mapped_type& result)
 
     // Look up data item. Abort if key does not exist.
     index_mutex.lock();
-    History::ptr history;
+    history_ptr history;
     auto status = index->get(key, history);
     index_mutex.unlock();
     if (!status) {
         return abort(tx, VALUE_NOT_FOUND);
     }
+    return readHistory(tx, history, result);
+}
+
+template <class Backend>
+int BasicStore<Backend>::multiRead(tx_ptr tx, const std::vector<key_type>& keys,
+        std::vector<mapped_type>& results)
+{
+    // Reject invalid or inactive transactions.
+    if (!isValidTransaction(tx))
+        return INVALID_TX;
+
+    // Look up all data items in one go (see NVHashmap::get)
+    std::vector<history_ptr> histories;
+    index_mutex.lock();
+    const auto found = index->get(keys, histories);
+    index_mutex.unlock();
+    if (found != keys.size())
+        return abort(tx, VALUE_NOT_FOUND);
+
+    // Request all histories, then the newest version of each. By the time
+    // a newest version is requested, its history should have arrived.
+    for (auto& history : histories)
+        __builtin_prefetch(history.get());
+    for (auto& history : histories) {
+        const auto head = history->chain.front();
+        if (head)
+            __builtin_prefetch(head.get());
+    }
+
+    results.resize(keys.size());
+    for (size_type i=0; i<keys.size(); ++i) {
+        const auto status = readHistory(tx, histories[i], results[i]);
+        if (status != OK)
+            return status;
+    }
+    return OK;
+}
+
+template <class Backend>
+int BasicStore<Backend>::readHistory(tx_ptr tx, history_ptr& history, mapped_type& result)
+{
+    // Most keys are not being written, so the newest version that is
+    // copied into the history is all we need to look at.
+    recoverHistory(history);
+    version_ptr candidate;
+    if (readInline(history, tx, candidate, result)) {
+        tx->getReadSet().push_back(candidate);
+        return OK;
+    }
 
     // Scan history for latest committed version which is older than tx.
-    history->mutex.lock();
-    auto candidate = getReadableSnapshot(history, tx);
-    history->mutex.unlock();
+    // No locking is required because new versions are published atomically
+    // (see VersionChain).
+    candidate = getReadableSnapshot(history, tx);
 
     // If no candidate was found then no version is visible and tx must fail
     if (!candidate)
         return abort(tx, VALUE_NOT_FOUND);
 
+    // Let subsequent reads take the short path
+    if (candidate == history->chain.front())
+        publishInline(history, candidate);
+
     // std::cout << "Store::read(): version found for key '" << key << "': {";
     // std::cout << "begin=" << candidate->begin;
     // std::cout << ", end=" << candidate->end;
@@ -141,7 +397,8 @@ int Store::read(Transaction::ptr tx, const key_type& key, mapped_type& result)
     return OK;
 }
 
-int Store::write(Transaction::ptr tx, const key_type& key, const mapped_type& value)
+template <class Backend>
+int BasicStore<Backend>::write(tx_ptr tx, const key_type& key, const mapped_type& value)
 {
     // std::cout << "Store::write(tx{id=" << tx->getId() << "}):" << '\n';
 
@@ -150,55 +407,174 @@ int Store::write(Transaction::ptr tx, const key_type& key, const mapped_type& va
         return INVALID_TX;
 
     // Check if item was written before in the transaction
-    auto& changeSet = tx->getChangeSet();
-    auto changeIter = changeSet.find(key);
-    if (changeIter != changeSet.end()) {
-        auto& mod = changeIter->second;
+    if (rewriteChange(tx, key, value))
+        return OK;
 
-        // Update the delta on the change set
-        mod.delta = value;
+    // std::cout << "write(): item not in change set" << std::endl;
 
-        // The version affected by this change was 'removed' earlier in this
-        // transaction so we change the modification from removal to update.
-        // Updates remain updates, as do inserts.
-        if (mod.code == Transaction::Mod::Kind::Remove) {
-            mod.code = Transaction::Mod::Kind::Update;
-        }
-        return OK;
+    index_mutex.lock();
+    history_ptr history;
+    index->get(key, history);
+    index_mutex.unlock();
+
+    return writeHistory(tx, key, history, value);
+}
+
+template <class Backend>
+int BasicStore<Backend>::multiWrite(tx_ptr tx,
+        const std::vector<std::pair<key_type, mapped_type>>& pairs)
+{
+    // Reject invalid or inactive transactions.
+    if (!isValidTransaction(tx))
+        return INVALID_TX;
+
+    // Items that were written before in the transaction only need their
+    // change set entries updated. Among the others, later pairs overwrite
+    // earlier ones with the same key.
+    std::vector<key_type> keys;
+    std::unordered_map<key_type, size_type> positions;
+    for (size_type i=0; i<pairs.size(); ++i) {
+        const auto& [key, value] = pairs[i];
+        if (rewriteChange(tx, key, value))
+            continue;
+        const auto [pos, isNew] = positions.emplace(key, i);
+        if (isNew)
+            keys.push_back(key);
+        else
+            pos->second = i;
     }
 
-    // std::cout << "write(): item not in change set" << std::endl;
+    // Look up all data items in one go (see NVHashmap::get)
+    std::vector<history_ptr> histories;
+    index_mutex.lock();
+    index->get(keys, histories);
+    index_mutex.unlock();
+
+    // Claim versions in the order of their histories in the pool. This way,
+    // concurrent batches that overlap meet at the same history first and
+    // one of them backs off, instead of each claiming a part of the other.
+    std::vector<size_type> order(keys.size());
+    for (size_type i=0; i<order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_type a, size_type b){
+        return histories[a].raw().off < histories[b].raw().off;
+    });
+
+    // Tagging a version normally is a persistent transaction of its own.
+    // Here, all tags share a single one.
+    int status = OK;
+    Backend::exec_tx(pop, [&,this](){
+        for (const auto i : order) {
+            const auto& value = pairs[positions[keys[i]]].second;
+            status = writeHistory(tx, keys[i], histories[i], value, false);
+            if (status != OK)
+                break;
+        }
+    });
+
+    // Versions claimed so far are in the change set and are released
+    if (status != OK)
+        return abort(tx, status);
+    return OK;
+}
+
+template <class Backend>
+int BasicStore<Backend>::upsert(tx_ptr tx, const key_type& key, const mapped_type& value)
+{
+    // Reject invalid or inactive transactions.
+    if (!isValidTransaction(tx))
+        return INVALID_TX;
+
+    // Check if item was written before in the transaction
+    if (rewriteChange(tx, key, value))
+        return OK;
 
     index_mutex.lock();
-    History::ptr history;
+    history_ptr history;
     index->get(key, history);
     index_mutex.unlock();
 
     if (!history)
         return insert(tx, key, value);
 
-    history->mutex.lock();
-    Version::ptr candidate = getWritableSnapshot(history, tx);
-    if (!candidate) {
-        auto hasValidVersions = hasValidSnapshots(history);
-        history->mutex.unlock();
+    // Only the newest version can be writable. Everything below it has been
+    // invalidated by it, so there is no need to look any further.
+    recoverHistory(history);
+    auto newest = getNewestVersion(history);
+    if (!newest)
+        return insert(tx, key, value);
 
-        if (!hasValidVersions)
-            return insert(tx, key, value);
+    if (isWritable(newest, tx)) {
+        // Losing the race for the version means that someone else owns it
+        if (!tagVersion(history, newest, tx))
+            return abort(tx, WW_CONFLICT);
 
-        return abort(tx, VALUE_NOT_FOUND);
+        tx->getChangeSet().emplace(key, typename Transaction::Mod{
+            Transaction::Mod::Kind::Update,
+            newest,
+            value,
+            nullptr
+        });
+        return OK;
     }
 
-    // Mark version as temporary-invalid
-    pmdk::transaction::exec_tx(pop, [&,this](){
-        candidate->end.store(tx->getId());
-    });
+    // A committed removal leaves the key absent (see hasValidSnapshots)
+    const auto end = resolveStamp(newest->end.load());
+    if (!isTransactionId(resolveStamp(newest->begin)) && !isTransactionId(end) &&
+            end != TS_INFINITY)
+        return insert(tx, key, value);
+
+    // The newest version is in flight or newer than tx
+    return abort(tx, WW_CONFLICT);
+}
+
+template <class Backend>
+bool BasicStore<Backend>::rewriteChange(tx_ptr tx, const key_type& key,
+        const mapped_type& value)
+{
+    auto& changeSet = tx->getChangeSet();
+    auto changeIter = changeSet.find(key);
+    if (changeIter == changeSet.end())
+        return false;
+
+    auto& mod = changeIter->second;
+
+    // Update the delta on the change set
+    mod.delta = value;
+
+    // The version affected by this change was 'removed' earlier in this
+    // transaction so we change the modification from removal to update.
+    // Updates remain updates, as do inserts.
+    if (mod.code == Transaction::Mod::Kind::Remove) {
+        mod.code = Transaction::Mod::Kind::Update;
+    }
+    return true;
+}
+
+template <class Backend>
+int BasicStore<Backend>::writeHistory(tx_ptr tx, const key_type& key,
+        history_ptr& history, const mapped_type& value, bool abortOnFailure)
+{
+    if (!history)
+        return insert(tx, key, value);
+
+    // Find a writable version and mark it as temporary-invalid. If another
+    // transaction tags the same version first, we look again and will
+    // find the version owned by that transaction.
+    recoverHistory(history);
+    version_ptr candidate = getWritableSnapshot(history, tx);
+    while (candidate && !tagVersion(history, candidate, tx))
+        candidate = getWritableSnapshot(history, tx);
 
-    // Let others enter the history
-    history->mutex.unlock();
+    if (!candidate) {
+        if (!hasValidSnapshots(history))
+            return insert(tx, key, value);
+
+        return abortOnFailure ? abort(tx, VALUE_NOT_FOUND) : VALUE_NOT_FOUND;
+    }
 
     // Update changeset of tx
-    tx->getChangeSet().emplace(key, Transaction::Mod{
+    tx->getChangeSet().emplace(key, typename Transaction::Mod{
         Transaction::Mod::Kind::Update,
         candidate,
         value,
@@ -207,7 +583,8 @@ int Store::write(Transaction::ptr tx, const key_type& key, const mapped_type& va
     return OK;
 }
 
-int Store::drop(Transaction::ptr tx, const key_type& key)
+template <class Backend>
+int BasicStore<Backend>::drop(tx_ptr tx, const key_type& key)
 {
     // std::cout << "Store::drop(tx{id=" << tx->getId() << "}):" << '\n';
 
@@ -229,7 +606,7 @@ int Store::drop(Transaction::ptr tx, const key_type& key)
             // The version affected by this change was 'inserted' earlier in
             // this transaction so we simply discard the change altogether.
             changeSet.erase(changeIter);
-            pmdk::transaction::exec_tx(pop, [&,this](){
+            Backend::exec_tx(pop, [&,this](){
                 // Revalidate the temporarily invalidated version. This
                 // operation is not synchronized with regard to is history.
                 // However, the version already carries our id so we have full
@@ -246,140 +623,1277 @@ int Store::drop(Transaction::ptr tx, const key_type& key)
     }
 
     // Look up history of data item. Abort if key does not exist.
-    History::ptr history;
+    history_ptr history;
     index_mutex.lock();
     auto status = index->get(key, history);
     index_mutex.unlock();
     if (!status)
         return abort(tx, VALUE_NOT_FOUND);
 
-    // In order to ensure a consistent view on the history, we need to
-    // make sure that no one else can modify it.
-    history->mutex.lock();
+    // Tentatively invalidate V with our tx id. As in write(), losing the
+    // race for a version means looking again.
+    recoverHistory(history);
     auto candidate = getWritableSnapshot(history, tx);
-    if (!candidate) {
-        history->mutex.unlock();
+    while (candidate && !tagVersion(history, candidate, tx))
+        candidate = getWritableSnapshot(history, tx);
+
+    if (!candidate)
         return abort(tx, VALUE_NOT_FOUND);
+
+    tx->getChangeSet().emplace(key, typename Transaction::Mod{
+        Transaction::Mod::Kind::Remove,
+        candidate,
+        "",
+        nullptr
+    });
+    return OK;
+}
+
+template <class Backend>
+stamp_type BasicStore<Backend>::durableStamp()
+{
+    durable_mutex.lock();
+    const auto stamp = pendingStamps.empty()
+            ? timestampCounter.load() - TS_DELTA
+            : *pendingStamps.begin() - TS_DELTA;
+    durable_mutex.unlock();
+    return stamp;
+}
+
+template <class Backend>
+int BasicStore<Backend>::finalizeStatus() const
+{
+    return finalizeError.load();
+}
+
+template <class Backend>
+void BasicStore<Backend>::waitDurable(const stamp_type commitStamp)
+{
+    std::unique_lock<std::mutex> lock{durable_mutex};
+    durableChanged.wait(lock, [&,this](){
+        return pendingStamps.empty() || *pendingStamps.begin() > commitStamp;
+    });
+}
+
+template <class Backend>
+typename BasicStore<Backend>::SpaceReport BasicStore<Backend>::space()
+{
+    std::uint64_t allocated = 0;
+    Backend::ctl_get(pop, "stats.heap.curr_allocated", &allocated);
+    return SpaceReport{capacity, allocated};
+}
+
+template <class Backend>
+int BasicStore<Backend>::snapshotScan(const scan_callback& callback,
+        size_type parallelism)
+{
+    auto snapshot = pinSnapshot();
+
+    // Slices keep their keys if the index is resized during the scan
+    index_mutex.lock();
+    const auto slices = index->buckets();
+    index_mutex.unlock();
+
+    std::atomic<size_type> nextSlice{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto scan = [&,this](){
+        batch_type batch;
+        batch.reserve(SCAN_BATCH_SIZE);
+        while (!failed.load()) {
+            const auto first = nextSlice.fetch_add(SCAN_BATCH_SIZE);
+            if (first >= slices)
+                break;
+
+            batch.clear();
+            copySlices(snapshot, first, std::min(first + SCAN_BATCH_SIZE, slices),
+                    slices, batch);
+            try {
+                for (const auto& [key, value] : batch)
+                    callback(key, value);
+            }
+            catch (...) {
+                error_mutex.lock();
+                if (!error)
+                    error = std::current_exception();
+                error_mutex.unlock();
+                failed.store(true);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_type i = 1; i < parallelism; ++i)
+        workers.emplace_back(scan);
+    scan();
+    for (auto& worker : workers)
+        worker.join();
+
+    unpinSnapshot(snapshot);
+    if (error)
+        std::rethrow_exception(error);
+    return OK;
+}
+
+template <class Backend>
+int BasicStore<Backend>::exportSnapshot(const std::string& dir, size_type threads)
+{
+    SnapshotReport report;
+    return exportSnapshot(dir, threads, report);
+}
+
+template <class Backend>
+int BasicStore<Backend>::exportSnapshot(const std::string& dir, size_type threads,
+        SnapshotReport& report)
+{
+    const auto start = std::chrono::steady_clock::now();
+    report = SnapshotReport{0, 0, 0, 0};
+    threads = std::max<size_type>(threads, 1);
+
+    std::error_code ec;
+    std::experimental::filesystem::create_directories(dir, ec);
+    if (ec)
+        return IO_ERROR;
+
+    // Commits are logged after they became visible and their end stamps
+    // precede the stamp of the snapshot, so it reflects all records so far
+    report.position = changeLogEnd();
+    auto snapshot = pinSnapshot();
+    index_mutex.lock();
+    const auto slices = index->buckets();
+    index_mutex.unlock();
+
+    // Each shard covers a contiguous range of slices, so the shards are
+    // ordered by hash among each other as well
+    std::vector<int> results(threads, OK);
+    std::vector<SnapshotReport> reports(threads, SnapshotReport{0, 0, 0, 0});
+    auto write = [&,this](const size_type shard){
+        const auto first = slices * shard / threads;
+        const auto last = slices * (shard + 1) / threads;
+
+        SnapshotWriter writer{snapshotShardPath(dir, shard)};
+        SnapshotHeader header{};
+        std::copy(std::begin(SnapshotHeader::MAGIC), std::end(SnapshotHeader::MAGIC),
+                header.magic);
+        header.format = SnapshotHeader::FORMAT;
+        header.shard = shard;
+        header.shards = threads;
+        header.stamp = snapshot->getBegin();
+        header.slices = slices;
+        writer.writeHeader(header);
+
+        // Within a batch, pairs are sorted by slice and then by hash
+        batch_type batch;
+        std::vector<std::pair<std::pair<size_type, std::uint64_t>, size_type>> order;
+        for (auto i = first; i < last; i += SCAN_BATCH_SIZE) {
+            batch.clear();
+            copySlices(snapshot, i, std::min(i + SCAN_BATCH_SIZE, last), slices, batch);
+
+            order.clear();
+            for (size_type j = 0; j < batch.size(); ++j) {
+                const auto& key = batch[j].first;
+                const auto hash = IndexKeyHash::hash(key.data(), key.size());
+                order.emplace_back(std::make_pair(hash % slices, hash), j);
+            }
+            std::sort(order.begin(), order.end());
+            for (const auto& entry : order)
+                writer.append(batch[entry.second].first, batch[entry.second].second);
+        }
+
+        if (!writer.finish())
+            results[shard] = IO_ERROR;
+        reports[shard].keys = writer.records();
+        reports[shard].bytes = writer.size();
+    };
+
+    std::vector<std::thread> workers;
+    for (size_type shard = 1; shard < threads; ++shard)
+        workers.emplace_back(write, shard);
+    write(0);
+    for (auto& worker : workers)
+        worker.join();
+    unpinSnapshot(snapshot);
+
+    // Remove the surplus shards of an earlier export with more threads
+    int status = OK;
+    for (auto shard = threads; ; ++shard) {
+        const auto path = snapshotShardPath(dir, shard);
+        if (!std::experimental::filesystem::exists(path, ec))
+            break;
+        if (!std::experimental::filesystem::remove(path, ec)) {
+            status = IO_ERROR;
+            break;
+        }
+    }
+
+    for (size_type shard = 0; shard < threads; ++shard) {
+        report.keys += reports[shard].keys;
+        report.bytes += reports[shard].bytes;
+        if (results[shard] != OK)
+            status = results[shard];
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    report.seconds = std::chrono::duration<double>(stop - start).count();
+    return status;
+}
+
+template <class Backend>
+int BasicStore<Backend>::importSnapshot(const std::string& dir, size_type threads)
+{
+    SnapshotReport report;
+    return importSnapshot(dir, threads, report);
+}
+
+template <class Backend>
+int BasicStore<Backend>::importSnapshot(const std::string& dir, size_type threads,
+        SnapshotReport& report)
+{
+    const auto start = std::chrono::steady_clock::now();
+    report = SnapshotReport{0, 0, 0, 0};
+    threads = std::max<size_type>(threads, 1);
+
+    // The first shard tells how many there are, and all others must belong
+    // to the same export
+    SnapshotHeader expected{};
+    {
+        SnapshotReader reader{snapshotShardPath(dir, 0)};
+        if (!reader.good())
+            return IO_ERROR;
+        expected = reader.header();
+    }
+    const size_type shards = expected.shards;
+
+    std::vector<std::string> paths;
+    for (size_type shard = 0; shard < shards; ++shard)
+        paths.push_back(snapshotShardPath(dir, shard));
+
+    // Verify all shards before anything is loaded
+    std::atomic<size_type> nextShard{0};
+    std::atomic<size_type> keys{0};
+    std::atomic<size_type> bytes{0};
+    std::atomic<bool> damaged{false};
+    auto verify = [&](){
+        for (auto shard = nextShard++; shard < shards; shard = nextShard++) {
+            SnapshotReader reader{paths[shard]};
+            while (reader.next())
+                ;
+            const auto& header = reader.header();
+            if (!reader.valid() || header.shard != shard || header.shards != shards ||
+                    header.stamp != expected.stamp || header.slices != expected.slices)
+                damaged.store(true);
+            keys += reader.records();
+            bytes += reader.size();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_type i = 1; i < std::min(threads, shards); ++i)
+        workers.emplace_back(verify);
+    verify();
+    for (auto& worker : workers)
+        worker.join();
+    if (damaged.load())
+        return IO_ERROR;
+
+    LoadReport load;
+    SnapshotIterator first{paths};
+    auto status = bulkLoad(first, SnapshotIterator{}, keys.load(), load);
+    if (status == OK && first.failed())
+        status = IO_ERROR;
+
+    report.keys = load.keys;
+    report.bytes = bytes.load();
+    const auto stop = std::chrono::steady_clock::now();
+    report.seconds = std::chrono::duration<double>(stop - start).count();
+    return status;
+}
+
+template <class Backend>
+int BasicStore<Backend>::readChanges(position_type& position, size_type maxRecords,
+        std::vector<ChangeRecord>& records)
+{
+    std::vector<std::string> data;
+    const auto status = readChanges(position, maxRecords, data);
+
+    records.resize(data.size());
+    for (size_type i = 0; i < data.size(); ++i)
+        decodeChanges(data[i], records[i]);
+    return status;
+}
+
+template <class Backend>
+int BasicStore<Backend>::readChanges(position_type& position, size_type maxRecords,
+        std::vector<std::string>& records)
+{
+    records.clear();
+
+    // Records are copied under the lock, so they cannot be evicted meanwhile
+    std::lock_guard<std::mutex> guard{log_mutex};
+    if (!changeLog)
+        return OK;
+    if (position < logBegin || position > logEnd)
+        return LOG_TRUNCATED;
+
+    while (position < logEnd && records.size() < maxRecords) {
+        records.emplace_back();
+        changeLog->read(position, records.back());
+    }
+    return OK;
+}
+
+template <class Backend>
+typename BasicStore<Backend>::position_type BasicStore<Backend>::changeLogBegin()
+{
+    std::lock_guard<std::mutex> guard{log_mutex};
+    return logBegin;
+}
+
+template <class Backend>
+typename BasicStore<Backend>::position_type BasicStore<Backend>::changeLogEnd()
+{
+    std::lock_guard<std::mutex> guard{log_mutex};
+    return logEnd;
+}
+
+template <class Backend>
+size_type BasicStore<Backend>::recordDecision(const std::uint64_t id)
+{
+    std::unique_lock<std::mutex> lock{durable_mutex};
+    durableChanged.wait(lock, [this](){ return !freeDecisions.empty(); });
+    const auto entry = freeDecisions.back();
+    freeDecisions.pop_back();
+    lock.unlock();
+
+    // A single word is written back atomically
+    decisionTable[entry] = id;
+    Backend::persist(pop, &decisionTable[entry], sizeof(std::uint64_t));
+    return entry;
+}
+
+template <class Backend>
+void BasicStore<Backend>::forgetDecision(const size_type entry)
+{
+    decisionTable[entry] = 0;
+    Backend::persist(pop, &decisionTable[entry], sizeof(std::uint64_t));
+
+    durable_mutex.lock();
+    freeDecisions.push_back(entry);
+    durable_mutex.unlock();
+    durableChanged.notify_all();
+}
+
+template <class Backend>
+std::vector<std::uint64_t> BasicStore<Backend>::recordedDecisions(pool_type& pop)
+{
+    std::vector<std::uint64_t> ids;
+    auto root = pop.get_root();
+    if (!root->decisions)
+        return ids;
+    for (size_type i = 0; i < root->decisionCount.get_ro(); ++i)
+        if (root->decisions[i])
+            ids.push_back(root->decisions[i]);
+    return ids;
+}
+
+template <class Backend>
+void BasicStore<Backend>::clearDecisions()
+{
+    auto root = pop.get_root();
+    if (!root->decisions)
+        return;
+
+    const auto count = root->decisionCount.get_ro();
+    Backend::exec_tx(pop, [&,this](){
+        Backend::snapshot(decisionTable, count * sizeof(std::uint64_t));
+        std::fill(decisionTable, decisionTable + count, 0);
+    });
+
+    durable_mutex.lock();
+    freeDecisions.clear();
+    for (size_type i = count; i > 0; --i)
+        freeDecisions.push_back(i - 1);
+    durable_mutex.unlock();
+}
+
+template <class Backend>
+typename BasicStore<Backend>::position_type BasicStore<Backend>::replicatedPosition()
+{
+    return pop.get_root()->replicated.get_ro();
+}
+
+template <class Backend>
+void BasicStore<Backend>::setReplicatedPosition(const position_type position)
+{
+    // A single word is written back atomically
+    auto root = pop.get_root();
+    root->replicated.get_rw() = position;
+    Backend::persist(pop, &root->replicated, sizeof(root->replicated));
+}
+
+template <class Backend>
+bool BasicStore<Backend>::waitChanges(const position_type position,
+        const std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock{log_mutex};
+    return logChanged.wait_for(lock, timeout, [&,this](){
+        return logEnd > position;
+    });
+}
+
+template <class Backend>
+void BasicStore<Backend>::print()
+{
+    const auto end = index->end();
+    std::cerr << "--" << std::endl;
+    std::cerr << "buckets: " << index->buckets() << std::endl;
+    std::cerr << "size: " << index->size() << std::endl;
+    std::cerr << "--" << std::endl;
+    for (auto it = index->begin(); it != end; ++it) {
+        std::cerr << "key: "  << (*it)->key.get_ro().to_std_string() << std::endl;
+
+        size_type i = 0;
+        auto history = (*it)->value;
+        for (auto v : history->chain) {
+            if (i++ != 0)
+                std::cerr << "  --" << std::endl;
+            std::cerr << "  data : " << v->data.to_std_string() << std::endl;
+            std::cerr << "  began: " << v->begin << std::endl;
+            std::cerr << "  ended: " << v->end<< std::endl;
+        }
+        if (i != 0)
+            std::cerr << std::endl;
+    }
+}
+
+// ############################################################################
+// PRIVATE API
+// ############################################################################
+
+template <class Backend>
+void BasicStore<Backend>::init()
+{
+    // Retrieve volatile pointer to index. This is done to avoid expensive calls
+    // to the overloaded dereference operators in pmdk::persistent_ptr<T>.
+    auto root = pop.get_root();
+
+    // Commits of the previous session must be finalized before any history
+    // is recovered, or their versions would be taken for uncommitted ones
+    initChangeLog();
+    initDecisions();
+    recoverCommits();
+
+    // Histories retired in the previous session can no longer be accessed
+    // by anyone, so they are freed right away (see reclaimHistories).
+    // Pools created before retired histories existed lack the list and
+    // volatile pools start out empty.
+    Backend::exec_tx(pop, [&](){
+        if (!root->index)
+            root->index = Backend::template make<index_type>();
+        if (!root->retired)
+            root->retired = Backend::template make<retired_list_type>();
+        for (auto& hist : *root->retired)
+            Backend::template destroy<History>(hist);
+        root->retired->clear(pop);
+    });
+    index = root->index.get();
+    retired = root->retired.get();
+
+    // Allocation statistics are off by default but needed for space()
+    int enableStats = 1;
+    Backend::ctl_set(pop, "stats.enabled", &enableStats);
+    if (config.growthStep) {
+        std::uint64_t step = config.growthStep;
+        Backend::ctl_set(pop, "heap.size.granularity", &step);
+    }
+    capacity = root->capacity.get_ro();
+
+    // Allocation classes are not persistent, so they are registered anew
+    if constexpr (Backend::PERSISTENT) {
+        VersionAllocClass::enable(pop.handle(), config.allocClasses);
+        LineAllocClass::enable(pop.handle(), config.allocClasses);
+    }
+
+    // Start a new session. Histories that were not recovered in this
+    // session carry the number of an earlier session.
+    Backend::exec_tx(pop, [&](){
+        ++root->epoch.get_rw();
+    });
+    epoch = root->epoch.get_ro();
+
+    // Continue where the previous session left off. All timestamps of earlier
+    // sessions are below the persistent limit, so timestamps of this session
+    // compare correctly with the ones that were persisted in versions.
+    const auto limit = std::max<stamp_type>(TS_START, root->stampLimit.get_ro());
+    timestampCounter.store(limit);
+    stampLimit.store(limit);
+
+    // With lazy recovery, each history is recovered when it is accessed for
+    // the first time in this session (see recoverHistory), so the store is
+    // ready right away. Optionally, a background thread takes care of the
+    // histories that are not accessed.
+    if (config.recovery == StoreConfig::Recovery::Lazy) {
+        if (deferFinalize())
+            finalizer = std::thread{&BasicStore::finalizeCommits, this};
+        if (config.backgroundRecovery)
+            sweeper = std::thread{&BasicStore::sweep, this};
+        return;
+    }
+
+    // Collapse the all histories. There is no point in keeping more than
+    // one version of an item across restarts. The reason is that all
+    // subsequent transactions in this newly initialized session are newer
+    // than the latest version and therefore should only see the latest
+    // version. Therefore we remove all other versions.
+    //
+    // Also, we must handle transaction ids from the previous session. These
+    // belong to transactions that never finished, so their changes are
+    // undone (see purgeHistory). Timestamps remain valid (see above), so
+    // histories without such ids and without outdated versions are not
+    // touched at all.
+    //
+    // Histories are independent of each other, so the buckets of the index
+    // are split into ranges that are recovered by separate threads.
+    // Removing emptied histories, however, modifies the index which is
+    // not thread-safe. Therefore, workers only collect the keys of emptied
+    // histories which are then removed after all workers have finished.
+    // If a worker fails, the others still run to completion before the
+    // first error is passed on, so no thread outlives the store.
+    const auto numBuckets = index->buckets();
+    auto numThreads = config.recoveryThreads;
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::max<size_type>(1, std::min(numThreads, numBuckets));
+
+    std::vector<std::vector<key_type>> emptied(numThreads);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto recover = [&,this](size_type t){
+        try {
+            recoverBuckets(t * numBuckets / numThreads,
+                    (t + 1) * numBuckets / numThreads, emptied[t]);
+        }
+        catch (...) {
+            error_mutex.lock();
+            if (!error)
+                error = std::current_exception();
+            error_mutex.unlock();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    try {
+        for (size_type t = 1; t < numThreads; ++t)
+            workers.emplace_back(recover, t);
+    }
+    catch (...) {
+        // Recover the ranges that are left without a worker right here
+        for (size_type t = workers.size() + 1; t < numThreads; ++t)
+            recover(t);
+    }
+    recover(0);
+    for (auto& worker : workers)
+        worker.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    // Purge left these histories empty, so we should remove them from
+    // the index and deallocate them
+    for (const auto& keys : emptied) {
+        for (const auto& key : keys) {
+            history_ptr hist;
+            index->get(key, hist);
+            Backend::exec_tx(pop, [&,this](){
+                index->erase(key, pop);
+                Backend::template destroy<History>(hist);
+            });
+        }
+    }
+
+    // Commits are finalized in the background only once the store is ready,
+    // so that a failed recovery leaves no thread behind
+    if (deferFinalize())
+        finalizer = std::thread{&BasicStore::finalizeCommits, this};
+}
+
+template <class Backend>
+void BasicStore<Backend>::recoverBuckets(size_type first, size_type last,
+        std::vector<key_type>& emptied)
+{
+    const auto end = index->end();
+    for (auto it = index->begin(first, last); it != end; ++it) {
+        auto& hist = (*it)->value;
+        if (needsRepair(hist)) {
+            Backend::exec_tx(pop, [&,this](){
+                purgeHistory(hist);
+            });
+        }
+
+        // Leave the index untouched (see init)
+        if (hist->chain.empty())
+            emptied.push_back((*it)->key.get_ro().to_std_string());
+    }
+}
+
+template <class Backend>
+void BasicStore<Backend>::recoverHistory(history_ptr& history)
+{
+    if (config.recovery != StoreConfig::Recovery::Lazy ||
+            history->epoch.load(std::memory_order_acquire) == epoch)
+        return;
+
+    // The history has not been touched in this session, so it may contain
+    // outdated versions and transaction ids from an earlier session. These
+    // are purged (see init). Either way, the history is marked as recovered.
+    //
+    // As opposed to eager recovery, a history that becomes empty is not
+    // removed from the index because other transactions may have looked it
+    // up already. It is treated like a history of removed versions.
+    //
+    // Purging unlinks versions which is not safe while others traverse the
+    // chain. Everyone who accesses the history in this session ends up here
+    // first, so they wait on its lock until the epoch is published.
+    //
+    // The guard releases the lock if the pool runs full.
+    std::lock_guard<std::mutex> guard{historyLocks.get(history.raw().off)};
+    if (history->epoch.load() != epoch) {
+        Backend::exec_tx(pop, [&,this](){
+            if (needsRepair(history))
+                purgeHistory(history);
+            Backend::snapshot(&history->epoch, sizeof(history->epoch));
+            history->epoch.store(epoch, std::memory_order_release);
+        });
+    }
+}
+
+template <class Backend>
+void BasicStore<Backend>::sweep()
+{
+    // Visit one bucket at a time, so the index is never locked for long.
+    // Buckets are addressed by position, so if the index grows concurrently
+    // some histories are visited twice and some are skipped. Neither is a
+    // problem because recovery is idempotent and skipped histories are
+    // recovered upon their first access.
+    for (size_type i = 0; !stopping.load(); ++i) {
+        index_mutex.lock();
+        if (i >= index->buckets()) {
+            index_mutex.unlock();
+            break;
+        }
+        const auto end = index->end();
+        for (auto it = index->begin(i, i + 1); it != end; ++it)
+            recoverHistory((*it)->value);
+        index_mutex.unlock();
+    }
+}
+
+template <class Backend>
+bool BasicStore<Backend>::deferFinalize() const
+{
+    return config.backgroundFinalize ||
+            config.durability == StoreConfig::Durability::Async ||
+            config.changeLogSize > 0;
+}
+
+template <class Backend>
+bool BasicStore<Backend>::isTraced(const std::uint64_t prepared) const
+{
+    return prepared != 0 || config.durability == StoreConfig::Durability::Sync;
+}
+
+template <class Backend>
+void BasicStore<Backend>::initDecisions()
+{
+    auto root = pop.get_root();
+    if (!root->decisions) {
+        if (!config.resolvePrepared)
+            return;
+        const auto count = std::max<size_type>(1, config.maxPendingCommits);
+        Backend::exec_tx(pop, [&,this](){
+            root->decisions = Backend::template make_array<std::uint64_t>(count);
+            std::fill(root->decisions.get(), root->decisions.get() + count, 0);
+            root->decisionCount = count;
+        });
+    }
+
+    decisionTable = root->decisions.get();
+    freeDecisions.clear();
+    for (size_type i = root->decisionCount.get_ro(); i > 0; --i)
+        if (decisionTable[i - 1] == 0)
+            freeDecisions.push_back(i - 1);
+}
+
+template <class Backend>
+void BasicStore<Backend>::initChangeLog()
+{
+    auto root = pop.get_root();
+    const auto size = config.changeLogSize;
+    if (root->changeLog && root->changeLog->capacity() != size) {
+        // Records are dropped, but positions continue where the old log ended
+        const auto start = root->changeLog->end();
+        Backend::exec_tx(pop, [&,this](){
+            Backend::template destroy<change_log_type>(root->changeLog);
+            root->changeLog = nullptr;
+            if (size)
+                root->changeLog = Backend::template make<change_log_type>(size, start);
+        });
+    }
+    else if (!root->changeLog && size) {
+        Backend::exec_tx(pop, [&,this](){
+            root->changeLog = Backend::template make<change_log_type>(size);
+        });
+    }
+
+    changeLog = root->changeLog.get();
+    if (changeLog) {
+        logBegin = changeLog->begin();
+        logEnd = changeLog->end();
+    }
+}
+
+template <class Backend>
+std::string BasicStore<Backend>::encodeChanges(const tx_ptr& tx)
+{
+    // stamp (u64), complete (u8), count (u32) and per change:
+    // kind (u8), key size (u32), value size (u32), key, value
+    std::string record;
+    const auto& changes = tx->getChangeSet();
+    if (changes.empty())
+        return record;
+
+    auto put = [&](const auto value){
+        record.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto putHeader = [&](const bool complete, const std::uint32_t count){
+        put(static_cast<std::uint64_t>(tx->getEnd()));
+        put(static_cast<std::uint8_t>(complete));
+        put(count);
+    };
+
+    putHeader(true, changes.size());
+    for (const auto& [key, change] : changes) {
+        put(static_cast<std::uint8_t>(change.code));
+        put(static_cast<std::uint32_t>(key.size()));
+        put(static_cast<std::uint32_t>(change.delta.size()));
+        record += key;
+        record += change.delta;
+    }
+
+    // Consumers still learn about commits that are too large for the log
+    if (changeLog && !changeLog->fits(record.size())) {
+        record.clear();
+        putHeader(false, 0);
+    }
+    return record;
+}
+
+template <class Backend>
+void BasicStore<Backend>::decodeChanges(const std::string& data, ChangeRecord& record)
+{
+    size_type offset = 0;
+    auto get = [&](auto& value){
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        offset += sizeof(value);
+    };
+    auto getString = [&](std::string& str, const std::uint32_t size){
+        str.assign(data, offset, size);
+        offset += size;
+    };
+
+    std::uint64_t stamp;
+    std::uint8_t complete;
+    std::uint32_t count;
+    get(stamp);
+    get(complete);
+    get(count);
+    record.stamp = stamp;
+    record.complete = complete;
+    record.changes.resize(count);
+    for (auto& change : record.changes) {
+        std::uint8_t kind;
+        std::uint32_t keySize;
+        std::uint32_t valueSize;
+        get(kind);
+        get(keySize);
+        get(valueSize);
+        change.kind = static_cast<typename ChangeRecord::Kind>(kind);
+        getString(change.key, keySize);
+        getString(change.value, valueSize);
+    }
+}
+
+template <class Backend>
+template <class F>
+void BasicStore<Backend>::logChanges(const std::vector<std::string>& records, F&& f)
+{
+    if (!changeLog || records.empty()) {
+        Backend::exec_tx(pop, std::forward<F>(f));
+        return;
+    }
+
+    // Only the newest records that fit into the log together are kept
+    size_type first = records.size();
+    size_type bytes = 0;
+    while (first > 0 && bytes + change_log_type::footprint(records[first - 1].size()) <=
+            changeLog->capacity()) {
+        bytes += change_log_type::footprint(records[first - 1].size());
+        --first;
+    }
+    size_type skipped = 0;
+    for (size_type i = 0; i < first; ++i)
+        skipped += change_log_type::footprint(records[i].size());
+
+    // Readers must not see the evicted records while they are overwritten
+    log_mutex.lock();
+    if (skipped)
+        changeLog->skip(skipped, pop);
+    changeLog->evict(bytes, pop);
+    logBegin = changeLog->begin();
+    logEnd = changeLog->end();
+    log_mutex.unlock();
+
+    Backend::exec_tx(pop, [&,this](){
+        f();
+        for (auto i = first; i < records.size(); ++i)
+            changeLog->append(records[i], pop);
+    });
+
+    log_mutex.lock();
+    logEnd = changeLog->end();
+    log_mutex.unlock();
+    logChanged.notify_all();
+}
+
+template <class Backend>
+void BasicStore<Backend>::recoverCommits()
+{
+    auto root = pop.get_root();
+    const size_type count = root->commitCount.get_ro();
+    const size_type wanted = std::max<size_type>(1, config.maxPendingCommits);
+
+    // Recovered commits are logged in the order of their end timestamps.
+    // Prepared commits count if they were decided to commit, otherwise
+    // their versions are rolled back like those of any unfinished commit.
+    std::vector<commit_slot*> traced;
+    std::vector<commit_slot*> undecided;
+    std::vector<commit_slot*> unfinished;
+    for (size_type i=0; i<count; ++i) {
+        auto& slot = root->commits[i];
+        if (slot.end.get_ro() == 0) {
+            if (slot.count.get_ro() != 0)
+                unfinished.push_back(&slot);
+            continue;
+        }
+        const auto prepared = slot.prepared.get_ro();
+        if (prepared == 0 || (config.resolvePrepared && config.resolvePrepared(prepared)))
+            traced.push_back(&slot);
+        else
+            undecided.push_back(&slot);
+    }
+    std::sort(traced.begin(), traced.end(), [](const auto a, const auto b){
+        return a->end.get_ro() < b->end.get_ro();
+    });
+
+    std::vector<std::string> records;
+    for (const auto slot : traced)
+        if (slot->change)
+            records.emplace_back(slot->change.get(), slot->changeSize.get_ro());
+
+    logChanges(records, [&,this](){
+        for (const auto slotPtr : traced) {
+            auto& slot = *slotPtr;
+
+            // Same as finalize()
+            const stamp_type end = slot.end.get_ro();
+            for (size_type j=0; j<slot.count.get_ro(); ++j) {
+                auto v_new = slot.versions[2 * j];
+                auto v_origin = slot.versions[2 * j + 1];
+                if (v_new) {
+                    Backend::snapshot(&v_new->begin, sizeof(v_new->begin));
+                    v_new->begin = end;
+                }
+                if (v_origin) {
+                    Backend::snapshot(&v_origin->end, sizeof(v_origin->end));
+                    v_origin->end.store(end);
+                }
+            }
+            clearSlot(slot);
+        }
+        for (const auto slot : undecided)
+            clearSlot(*slot);
+
+        // Versions of commits that were not durable are purged from their
+        // chains like any others that carry a transaction id (see
+        // purgeHistory). The ones that were never published are freed here.
+        for (const auto slotPtr : unfinished) {
+            auto& slot = *slotPtr;
+            for (size_type j=0; j<slot.count.get_ro(); ++j) {
+                auto v_new = slot.versions[2 * j];
+                if (!v_new)
+                    continue;
+                bool published = false;
+                for (auto& v : slot.histories[j]->chain)
+                    published = published || v == v_new;
+                if (!published)
+                    Backend::template destroy<Version>(v_new);
+            }
+            clearSlot(slot);
+        }
+    });
+
+    Backend::exec_tx(pop, [&,this](){
+        if (count != wanted) {
+            if (root->commits)
+                Backend::template destroy_array<commit_slot>(root->commits, count);
+            root->commits = nullptr;
+            if (wanted)
+                root->commits = Backend::template make_array<commit_slot>(wanted);
+            root->commitCount = wanted;
+        }
+    });
+
+    commitSlots = root->commits.get();
+    freeSlots.clear();
+    for (size_type i=wanted; i>0; --i)
+        freeSlots.push_back(i - 1);
+}
+
+template <class Backend>
+typename BasicStore<Backend>::commit_slot* BasicStore<Backend>::claimSlot()
+{
+    std::unique_lock<std::mutex> lock{durable_mutex};
+    durableChanged.wait(lock, [this](){ return !freeSlots.empty(); });
+    const auto i = freeSlots.back();
+    freeSlots.pop_back();
+    return &commitSlots[i];
+}
+
+template <class Backend>
+void BasicStore<Backend>::releaseSlot(commit_slot* slot)
+{
+    if (!slot)
+        return;
+
+    durable_mutex.lock();
+    freeSlots.push_back(slot - commitSlots);
+    durable_mutex.unlock();
+    durableChanged.notify_all();
+}
+
+template <class Backend>
+void BasicStore<Backend>::clearSlot(commit_slot& slot)
+{
+    Backend::template destroy_array<version_ptr>(slot.versions, 2 * slot.count.get_ro());
+    slot.versions = nullptr;
+    if (slot.histories)
+        Backend::template destroy_array<history_ptr>(slot.histories, slot.count.get_ro());
+    slot.histories = nullptr;
+    slot.count = 0;
+    slot.end = 0;
+    if (slot.change)
+        Backend::template destroy_array<char>(slot.change, slot.changeSize.get_ro());
+    slot.change = nullptr;
+    slot.changeSize = 0;
+    slot.prepared = 0;
+}
+
+template <class Backend>
+typename BasicStore<Backend>::commit_slot* BasicStore<Backend>::takePreparedSlot(
+        const tx_ptr& tx)
+{
+    // Most transactions were never prepared
+    if (numPrepared.load() == 0)
+        return nullptr;
+
+    std::lock_guard<std::mutex> guard{durable_mutex};
+    const auto it = preparedSlots.find(tx->getId());
+    if (it == preparedSlots.end())
+        return nullptr;
+    const auto slot = it->second;
+    preparedSlots.erase(it);
+    --numPrepared;
+    return slot;
+}
+
+template <class Backend>
+void BasicStore<Backend>::queueCommit(tx_ptr tx, commit_slot* slot)
+{
+    std::unique_lock<std::mutex> lock{durable_mutex};
+    durableChanged.wait(lock, [this](){
+        return pendingCommits.size() < config.maxPendingCommits;
+    });
+
+    // Commits are queued in the order in which they become visible. A commit
+    // may depend on the ones that became visible before it (e.g. by reading
+    // their versions), so it must not become durable before them.
+    tx->getStatus().store(Transaction::COMMITTED);
+    pendingCommits.emplace_back(tx, slot);
+    if (config.durability == StoreConfig::Durability::Async)
+        pendingStamps.insert(tx->getEnd());
+    lock.unlock();
+    durableChanged.notify_all();
+}
+
+template <class Backend>
+void BasicStore<Backend>::finalizeCommits()
+{
+    std::vector<std::pair<tx_ptr, commit_slot*>> batch;
+    std::vector<std::string> records;
+    size_type limit = DURABLE_BATCH_SIZE;
+    size_type delay = FINALIZE_RETRY_DELAY;
+    std::unique_lock<std::mutex> lock{durable_mutex};
+    for (;;) {
+        durableChanged.wait(lock, [this](){
+            return stopping.load() || !pendingCommits.empty();
+        });
+        if (pendingCommits.empty())
+            break;
+
+        const auto count = std::min(pendingCommits.size(), limit);
+        batch.assign(pendingCommits.begin(), pendingCommits.begin() + count);
+        lock.unlock();
+
+        records.clear();
+        if (changeLog) {
+            for (auto& entry : batch) {
+                auto record = encodeChanges(entry.first);
+                if (!record.empty())
+                    records.push_back(std::move(record));
+            }
+        }
+
+        // Recovery drops versions that still carry a transaction id unless
+        // their commit is traced in a slot. Without slots, each batch
+        // becomes durable at once when this transaction ends, along with
+        // its records in the change log.
+        int status = OK;
+        try {
+            logChanges(records, [&,this](){
+                for (auto& [tx, slot] : batch) {
+                    finalize(tx);
+                    if (slot)
+                        clearSlot(*slot);
+                }
+            });
+        }
+        catch (const pmem::transaction_alloc_error&) {
+            status = OUT_OF_SPACE;
+        }
+        catch (...) {
+            status = IO_ERROR;
+        }
+
+        // The batch was rolled back. A smaller one needs less space for the
+        // undo log. A single commit is retried after a pause, in which
+        // others may free space, unless the store shuts down. Its slot (if
+        // any) then lets recovery finalize it.
+        if (status != OK) {
+            finalizeError.store(status);
+            lock.lock();
+            if (count > 1) {
+                limit = std::max<size_type>(1, count / 2);
+            }
+            else {
+                if (stopping.load())
+                    break;
+                durableChanged.wait_for(lock, std::chrono::milliseconds(delay),
+                        [this](){ return stopping.load(); });
+                delay = std::min(2 * delay, FINALIZE_RETRY_LIMIT);
+            }
+            continue;
+        }
+        finalizeError.store(OK);
+        limit = std::min(2 * limit, DURABLE_BATCH_SIZE);
+        delay = FINALIZE_RETRY_DELAY;
+
+        for (auto& entry : batch)
+            completeCommit(entry.first);
+
+        lock.lock();
+        for (auto& [tx, slot] : batch) {
+            if (config.durability == StoreConfig::Durability::Async)
+                pendingStamps.erase(pendingStamps.find(tx->getEnd()));
+            if (slot)
+                freeSlots.push_back(slot - commitSlots);
+        }
+        pendingCommits.erase(pendingCommits.begin(), pendingCommits.begin() + count);
+        durableChanged.notify_all();
+    }
+}
+
+template <class Backend>
+void BasicStore<Backend>::completeCommit(tx_ptr tx)
+{
+    // Now that all its modifications have become persistent, we can safely
+    // remove this transaction from our list
+    removeTransaction(tx);
+
+    // Removed items are gone for good unless they are written again. Their
+    // histories are taken out of the index right away and freed as soon as
+    // no transaction can access them anymore.
+    for (const auto& [key, change] : tx->getChangeSet())
+        if (change.code == Transaction::Mod::Kind::Remove)
+            retireHistory(key);
+    reclaimHistories();
+}
+
+template <class Backend>
+void BasicStore<Backend>::retireHistory(const key_type& key)
+{
+    // Unlinking and recording happen in one persistent transaction, so a
+    // retired history is never lost to a crash (see init)
+    index_mutex.lock();
+    history_ptr history;
+    if (index->get(key, history) && isObsolete(history)) {
+        // Running scans may still see it, so it is kept until they finish.
+        // The persistent list is shared with reclaimHistories, which frees
+        // from its front, so it is appended to under the same lock.
+        retire_mutex.lock();
+        if (isPinned(history)) {
+            pinnedKeys.push_back(key);
+            retire_mutex.unlock();
+            index_mutex.unlock();
+            return;
+        }
+
+        try {
+            Backend::exec_tx(pop, [&,this](){
+                index->erase(key, pop);
+                retired->push_back(history, pop);
+            });
+
+            // Transactions that are active now may still hold the history.
+            // Transactions that begin later cannot find it anymore.
+            retiredHistories.emplace_back(timestampCounter.load(), history);
+        }
+        catch (const pmem::transaction_alloc_error&) {
+            // The history stays in the index and is purged on restart
+        }
+        retire_mutex.unlock();
+    }
+    index_mutex.unlock();
+}
+
+template <class Backend>
+void BasicStore<Backend>::reclaimHistories()
+{
+    // One reclaimer at a time is enough
+    if (!retire_mutex.try_lock())
+        return;
+
+    if (!retiredHistories.empty()) {
+        // Only a prefix can have expired, as histories are retired in the
+        // order of their stamps. In the persistent list, the oldest ones are
+        // in the first node, so each is erased without a walk. Should one
+        // not be found there, it is freed on restart.
+        const auto oldest = getOldestActiveStamp();
+        auto expired = retiredHistories.begin();
+        while (expired != retiredHistories.end() && expired->first <= oldest)
+            ++expired;
+
+        if (expired != retiredHistories.begin()) {
+            try {
+                Backend::exec_tx(pop, [&,this](){
+                    for (auto it = retiredHistories.begin(); it != expired; ++it)
+                        if (retired->erase_front(it->second, pop))
+                            Backend::template destroy<History>(it->second);
+                });
+                retiredHistories.erase(retiredHistories.begin(), expired);
+            }
+            catch (const pmem::transaction_alloc_error&) {
+                // Nothing was freed, so the next reclaimer tries again
+            }
+        }
     }
+    retire_mutex.unlock();
+}
 
-    // Tentatively invalidate V with our tx id
-    pmdk::transaction::exec_tx(pop, [&,this](){
-        candidate->end.store(tx->getId());
-    });
-    history->mutex.unlock();
+template <class Backend>
+void BasicStore<Backend>::addTransaction(const tx_ptr& tx)
+{
+    active_mutex.lock();
+    activeStamps.insert(tx->getBegin());
+    active_mutex.unlock();
+    tx_tab.insert(tx->getId(), tx);
+}
 
-    tx->getChangeSet().emplace(key, Transaction::Mod{
-        Transaction::Mod::Kind::Remove,
-        candidate,
-        "",
-        nullptr
-    });
-    return OK;
+template <class Backend>
+void BasicStore<Backend>::removeTransaction(const tx_ptr& tx)
+{
+    tx_tab.erase(tx->getId());
+    active_mutex.lock();
+    activeStamps.erase(activeStamps.find(tx->getBegin()));
+    active_mutex.unlock();
 }
 
-void Store::print()
+template <class Backend>
+stamp_type BasicStore<Backend>::getOldestActiveStamp()
 {
-    const auto end = index->end();
-    std::cerr << "--" << std::endl;
-    std::cerr << "buckets: " << index->buckets() << std::endl;
-    std::cerr << "size: " << index->size() << std::endl;
-    std::cerr << "--" << std::endl;
-    for (auto it = index->begin(); it != end; ++it) {
-        std::cerr << "key: "  << (*it)->key.get_ro().to_std_string() << std::endl;
+    auto oldest = timestampCounter.load();
+    std::lock_guard<std::mutex> guard{active_mutex};
+    if (!activeStamps.empty())
+        oldest = std::min(oldest, *activeStamps.begin());
+    return oldest;
+}
 
-        size_type i = 0;
-        auto history = (*it)->value;
-        for (auto v : history->chain) {
-            if (i++ != 0)
-                std::cerr << "  --" << std::endl;
-            std::cerr << "  data : " << v->data.to_std_string() << std::endl;
-            std::cerr << "  began: " << v->begin << std::endl;
-            std::cerr << "  ended: " << v->end<< std::endl;
-        }
-        if (i != 0)
-            std::cerr << std::endl;
+template <class Backend>
+bool BasicStore<Backend>::isPinned(const history_ptr& history)
+{
+    // Versions of obsolete histories carry timestamps only (see isObsolete)
+    for (const auto stamp : scanStamps) {
+        for (auto& v : history->chain)
+            if (v->begin < stamp && v->end.load() > stamp)
+                return true;
     }
+    return false;
 }
 
-// ############################################################################
-// PRIVATE API
-// ############################################################################
-
-void Store::init()
+template <class Backend>
+bool BasicStore<Backend>::isObsolete(const history_ptr& history)
 {
-    // Retrieve volatile pointer to index. This is done to avoid expensive calls
-    // to the overloaded dereference operators in pmdk::persistent_ptr<T>.
-    index = pop.get_root()->index.get();
-
-    // Collapse the all histories. There is no point in keeping more than
-    // one version of an item across restarts. The reason is that all
-    // subsequent transactions in this newly initialized session are newer
-    // than the latest version and therefore should only see the latest
-    // version. Therefore we remove all other versions.
-    //
-    // Also, we must handle timestamps from the previous session. Unless we hold
-    // the timestamp counter in persistent memory, which would make it even
-    // more costly than its atomic operations, we need to make all versions
-    // look like they had been committed before the first transaction of
-    // this session. To do that, we simply set the begin timestamps in all
-    // remaining versions to the initial value of the timestamp counter.
-    // However, versions that have been invalidated must be deleted.
-    // After that, we increase the timestamp counter.
-    //
-    // Last but not least, we should unlock all history mutexes, as they
-    // may have become persistent in a previous session.
-    const auto end = index->end();
-    for (auto it = index->begin(); it != end; ) {
-        auto& hist = (*it)->value;
-        pmdk::transaction::exec_tx(pop, [&,this](){
-            purgeHistory(hist);
-            if (hist->chain.empty()) {
-                // Purge left history empty, so we should remove it from
-                // the index and deallocate it
-                it = index->erase(it, pop);
-                pmdk::delete_persistent<History>(hist);
-            }
-            else {
-                // Release the lock on the current history, as it may have become
-                // persistent in a previous session
-                hist->mutex.unlock();
-                ++it;
-            }
-        });
+    for (auto& v : history->chain) {
+        if (isTransactionId(v->begin))
+            return false;
+        const auto v_end = v->end.load();
+        if (v_end == TS_INFINITY || isTransactionId(v_end))
+            return false;
     }
+    return true;
+}
 
-    // Increase timestamp counter. This way, all subsequent transactions
-    // of this session have higher timestamps than all the versions that
-    // were reset above.
-    timestampCounter.fetch_add(TS_DELTA);
+template <class Backend>
+bool BasicStore<Backend>::needsRepair(const history_ptr& history)
+{
+    for (auto& v : history->chain)
+        if (isTransactionId(v->begin) || v->end.load() != TS_INFINITY)
+            return true;
+    return false;
 }
 
-void Store::purgeHistory(History::ptr& history)
+template <class Backend>
+void BasicStore<Backend>::purgeHistory(history_ptr& history)
 {
-    const auto first_stamp = timestampCounter.load();
     auto& chain = history->chain;
     auto end = chain.end();
     for (auto it = chain.begin(); it != end; ) {
-        auto& v = *it;
+        // Copy the pointer because erase() moves the iterator
+        auto v = *it;
         if (isTransactionId(v->begin)) {
             // V was created before restart but the associated tx
             // never committed or failed to finalize timestamps.
             // Therefore, we have to delete V.
             it = chain.erase(it, pop);
-            pmdk::delete_persistent<Version>(v);
+            Backend::template destroy<Version>(v);
         }
         else if (v->end == TS_INFINITY) {
-            // V was valid before restart. Make it look like it was
-            // created during this session.
-            v->begin = first_stamp;
+            // V was valid before restart. Its begin timestamp is still
+            // valid because timestamps persist across sessions.
             ++it;
         }
         else if (isTransactionId(v->end)) {
             // V was invalidated but the associated transaction
-            // never committed, so it is valid. Now that V is valid
-            // again, make it look like it was created during this
-            // session.
-            v->begin = first_stamp;
+            // never committed, so it is valid.
             v->end = TS_INFINITY;
             ++it;
         }
@@ -387,14 +1901,138 @@ void Store::purgeHistory(History::ptr& history)
             // V was invalidated and the associated transaction
             // has committed so we do not need V anymore.
             it = chain.erase(it, pop);
-            pmdk::delete_persistent<Version>(v);
+            Backend::template destroy<Version>(v);
         }
     }
 }
 
-int Store::insert(Transaction::ptr tx, const key_type& key, const mapped_type& value)
+template <class Backend>
+bool BasicStore<Backend>::blockTransactions()
+{
+    // Loads run one at a time
+    load_mutex.lock();
+    loading.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Commits that are not yet finalized are still in the table, so they are
+    // waited for. This includes durable ones (see waitDurable).
+    std::unique_lock<std::mutex> lock{durable_mutex};
+    durableChanged.wait(lock, [this](){ return pendingCommits.empty(); });
+    lock.unlock();
+    if (tx_tab.empty())
+        return true;
+
+    unblockTransactions();
+    return false;
+}
+
+template <class Backend>
+void BasicStore<Backend>::unblockTransactions()
+{
+    loading.store(false);
+    load_mutex.unlock();
+}
+
+template <class Backend>
+int BasicStore<Backend>::loadBatch(const batch_type& batch, stamp_type stamp)
+{
+    // No transaction is running, so versions can be created in their final
+    // (committed) state and histories need no locking.
+    int status = OK;
+    index_mutex.lock();
+    try {
+        Backend::exec_tx(pop, [&,this](){
+            for (const auto& [key, value] : batch) {
+                auto version = Backend::template make_in<VersionAllocClass, Version>(pop);
+                version->begin = stamp;
+                version->data = value;
+                version->end = TS_INFINITY;
+
+                history_ptr history;
+                if (index->get(key, history)) {
+                    // Invalidate all valid versions of an existing key
+                    recoverHistory(history);
+                    for (auto& v : history->chain) {
+                        if (v->end == TS_INFINITY) {
+                            Backend::snapshot(&v->end, sizeof(v->end));
+                            v->end.store(stamp);
+                            clearInline(history, v);
+                        }
+                    }
+                }
+                else {
+                    history = Backend::template make_in<LineAllocClass, History>(pop, epoch);
+                    index->put(key, history, pop);
+                }
+                history->chain.push(version, pop);
+                publishInline(history, version);
+            }
+        });
+    }
+    catch (const pmem::transaction_alloc_error&) {
+        // The whole batch was rolled back
+        status = OUT_OF_SPACE;
+    }
+    index_mutex.unlock();
+    return status;
+}
+
+template <class Backend>
+typename BasicStore<Backend>::tx_ptr BasicStore<Backend>::pinSnapshot()
+{
+    // The snapshot behaves like a read-only transaction that never shows
+    // up in the transaction table, so it does not hold back reclamation.
+    // Its timestamp is taken under retire_mutex, so every history retired
+    // after this point is checked against it (see retireHistory).
+    retire_mutex.lock();
+    auto snapshot = std::make_shared<Transaction>(
+        idCounter.fetch_add(TS_DELTA),
+        nextStamp()
+    );
+    scanStamps.insert(snapshot->getBegin());
+    retire_mutex.unlock();
+    return snapshot;
+}
+
+template <class Backend>
+void BasicStore<Backend>::unpinSnapshot(const tx_ptr& snapshot)
+{
+    // Retry the histories that were kept for this snapshot
+    std::vector<key_type> keys;
+    retire_mutex.lock();
+    scanStamps.erase(scanStamps.find(snapshot->getBegin()));
+    keys.swap(pinnedKeys);
+    retire_mutex.unlock();
+    for (const auto& key : keys)
+        retireHistory(key);
+    reclaimHistories();
+}
+
+template <class Backend>
+void BasicStore<Backend>::copySlices(const tx_ptr& snapshot, size_type first,
+        size_type last, size_type slices, batch_type& batch)
+{
+    // Histories are never accessed without the index lock, so they cannot
+    // be freed while being copied
+    index_mutex.lock();
+    for (auto slice = first; slice < last; ++slice) {
+        index->for_each_in_slice(slice, slices, [&,this](auto& elem){
+            auto& history = elem->value;
+            recoverHistory(history);
+            auto v = getReadableSnapshot(history, snapshot);
+            if (v) {
+                batch.emplace_back(elem->key.get_ro().to_std_string(),
+                        v->data.to_std_string());
+            }
+        });
+    }
+    index_mutex.unlock();
+}
+
+template <class Backend>
+int BasicStore<Backend>::insert(tx_ptr tx, const key_type& key, const mapped_type& value)
 {
-    tx->getChangeSet().emplace(key, Transaction::Mod{
+    tx->getChangeSet().emplace(key, typename Transaction::Mod{
         Transaction::Mod::Kind::Insert,
         nullptr,
         value,
@@ -403,7 +2041,8 @@ int Store::insert(Transaction::ptr tx, const key_type& key, const mapped_type& v
     return OK;
 }
 
-Version::ptr Store::getWritableSnapshot(History::ptr& history, Transaction::ptr tx)
+template <class Backend>
+typename BasicStore<Backend>::version_ptr BasicStore<Backend>::getWritableSnapshot(history_ptr& history, tx_ptr tx)
 {
     // std::cout << "Store::getWritableSnapshot(tx{id=" << tx->getId() << "}):" << '\n';
 
@@ -414,7 +2053,29 @@ Version::ptr Store::getWritableSnapshot(History::ptr& history, Transaction::ptr
     return nullptr;
 }
 
-Version::ptr Store::getReadableSnapshot(History::ptr& history, Transaction::ptr tx)
+template <class Backend>
+typename BasicStore<Backend>::version_ptr BasicStore<Backend>::getNewestVersion(history_ptr& history)
+{
+    // Failed transactions leave their versions in the history, either with
+    // their id or, once rolled back, with zeroed timestamps. These are never
+    // visible to anyone.
+    for (auto& v : history->chain) {
+        const auto begin = v->begin;
+        if (begin == TS_ZERO && v->end.load() == TS_ZERO)
+            continue;
+        if (isTransactionId(begin)) {
+            tx_ptr other_tx;
+            tx_tab.find(begin, other_tx);
+            if (other_tx && other_tx->getStatus().load() == Transaction::FAILED)
+                continue;
+        }
+        return v;
+    }
+    return nullptr;
+}
+
+template <class Backend>
+typename BasicStore<Backend>::version_ptr BasicStore<Backend>::getReadableSnapshot(history_ptr& history, tx_ptr tx)
 {
     // std::cout << "Store::getReadableSnapshot(tx{id=" << tx->getId() << "}):" << '\n';
 
@@ -425,11 +2086,97 @@ Version::ptr Store::getReadableSnapshot(History::ptr& history, Transaction::ptr
     return nullptr;
 }
 
-bool Store::isReadable(Version::ptr& v, Transaction::ptr tx)
+template <class Backend>
+bool BasicStore<Backend>::readInline(history_ptr& history, tx_ptr tx,
+        version_ptr& version, std::string& result)
+{
+    // The copy is read like a seqlock. It is only trusted if inlineVersion
+    // is unchanged after all other fields were read.
+    auto hist = history.get();
+    const auto offset = hist->inlineVersion.load(std::memory_order_acquire);
+    if (offset == 0)
+        return false;
+
+    const auto epoch32 = hist->inlineEpoch.load(std::memory_order_relaxed);
+    const auto begin = hist->inlineBegin.load(std::memory_order_relaxed);
+    const auto size = hist->inlineSize.load(std::memory_order_relaxed);
+    if (epoch32 != static_cast<std::uint32_t>(epoch) || begin >= tx->getBegin())
+        return false;
+
+    // A newer version may be pending, in which case the chain must be
+    // scanned as usual
+    auto head = hist->chain.front();
+    if (head.raw().off != offset)
+        return false;
+
+    const auto isInline = size <= History::INLINE_CAPACITY;
+    if (isInline)
+        result.assign(hist->inlineData, size);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (hist->inlineVersion.load(std::memory_order_relaxed) != offset)
+        return false;
+
+    // Payloads are immutable, so larger ones are taken from the version
+    if (!isInline)
+        result = head->data.to_std_string();
+    version = head;
+    return true;
+}
+
+template <class Backend>
+void BasicStore<Backend>::publishInline(history_ptr& history, version_ptr& v)
+{
+    // Only committed versions that nobody has claimed are copied
+    if (isTransactionId(v->begin) || v->end.load() != TS_INFINITY)
+        return;
+
+    // Readers do not wait for each other. One copy is enough.
+    auto& mutex = historyLocks.get(history.raw().off);
+    if (!mutex.try_lock())
+        return;
+
+    auto hist = history.get();
+    const auto offset = v.raw().off;
+    const auto epoch32 = static_cast<std::uint32_t>(epoch);
+    if (hist->inlineVersion.load() != offset ||
+            hist->inlineEpoch.load(std::memory_order_relaxed) != epoch32) {
+        const auto size = v->data.size.get_ro();
+
+        hist->inlineVersion.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        hist->inlineEpoch.store(epoch32, std::memory_order_relaxed);
+        hist->inlineBegin.store(v->begin, std::memory_order_relaxed);
+        hist->inlineSize.store(size, std::memory_order_relaxed);
+        if (size <= History::INLINE_CAPACITY)
+            for (size_type i=0; i<size; ++i)
+                hist->inlineData[i] = v->data.data[i];
+        hist->inlineVersion.store(offset);
+
+        // A writer may have claimed v after the check above. Either we see
+        // its id now or it sees our copy afterwards and clears it.
+        if (v->end.load() != TS_INFINITY)
+            clearInline(history, v);
+    }
+    mutex.unlock();
+}
+
+template <class Backend>
+void BasicStore<Backend>::clearInline(history_ptr& history, const version_ptr& v)
+{
+    auto offset = v.raw().off;
+    history->inlineVersion.compare_exchange_strong(offset, 0);
+}
+
+template <class Backend>
+bool BasicStore<Backend>::isReadable(version_ptr& v, tx_ptr tx)
 {
     // Read begin/end fields
-    auto v_begin = v->begin;
-    auto v_end = v->end.load();
+    stamp_type v_begin;
+    stamp_type v_end;
+    tx_ptr begin_tx;
+    tx_ptr end_tx;
+    loadVersion(v, v_begin, v_end, begin_tx, end_tx);
 
     // Check if begin-field contains a transaction id.
     // If so, then V might still be dirty so we have to
@@ -439,8 +2186,7 @@ bool Store::isReadable(Version::ptr& v, Transaction::ptr tx)
     // check if that happened before tx started.
     if (isTransactionId(v_begin)) {
         // Lookup the specified transaction
-        Transaction::ptr other_tx;
-        tx_tab.find(v_begin, other_tx);
+        const auto& other_tx = begin_tx;
 
         // V (written by other_tx) is only visible to tx if other_tx
         // has committed before tx started.
@@ -460,8 +2206,7 @@ bool Store::isReadable(Version::ptr& v, Transaction::ptr tx)
     if (isTransactionId(v_end)) {
 
         // Lookup the specified transaction
-        Transaction::ptr other_tx;
-        tx_tab.find(v_end, other_tx);
+        const auto& other_tx = end_tx;
 
         // V (possibly invalidated by other_tx) is only visible to tx
         // if other_tx is active, has aborted or has committed after
@@ -486,10 +2231,31 @@ bool Store::isReadable(Version::ptr& v, Transaction::ptr tx)
     return true;
 }
 
-bool Store::isWritable(Version::ptr& v, Transaction::ptr tx)
+template <class Backend>
+void BasicStore<Backend>::loadVersion(version_ptr& v, stamp_type& begin, stamp_type& end,
+        tx_ptr& beginTx, tx_ptr& endTx)
 {
-    auto v_begin = v->begin;
-    auto v_end = v->end.load();
+    for (;;) {
+        begin = v->begin;
+        end = v->end.load();
+        beginTx = nullptr;
+        endTx = nullptr;
+        if (isTransactionId(begin) && !tx_tab.find(begin, beginTx))
+            continue;
+        if (isTransactionId(end) && !tx_tab.find(end, endTx))
+            continue;
+        return;
+    }
+}
+
+template <class Backend>
+bool BasicStore<Backend>::isWritable(version_ptr& v, tx_ptr tx)
+{
+    stamp_type v_begin;
+    stamp_type v_end;
+    tx_ptr begin_tx;
+    tx_ptr end_tx;
+    loadVersion(v, v_begin, v_end, begin_tx, end_tx);
 
     // Check if begin-field contains a transaction id.
     // If so, then V might still be dirty so we have to
@@ -499,8 +2265,7 @@ bool Store::isWritable(Version::ptr& v, Transaction::ptr tx)
     // check if that happened before tx started.
     if (isTransactionId(v_begin)) {
         // Lookup the specified transaction
-        Transaction::ptr other_tx;
-        tx_tab.find(v_begin, other_tx);
+        const auto& other_tx = begin_tx;
 
         // V (written by other_tx) is only visible to tx if other_tx
         // has committed before tx started.
@@ -528,8 +2293,7 @@ bool Store::isWritable(Version::ptr& v, Transaction::ptr tx)
     // In that case we have to check its timestamp for invalidation.
     if (isTransactionId(v_end)) {
         // Lookup the specified transaction
-        Transaction::ptr other_tx;
-        tx_tab.find(v_end, other_tx);
+        const auto& other_tx = end_tx;
 
         // V is only visible to tx if other_tx has aborted.
         if (other_tx->getStatus().load() != Transaction::FAILED)
@@ -549,7 +2313,8 @@ bool Store::isWritable(Version::ptr& v, Transaction::ptr tx)
     return true;
 }
 
-int Store::validate(Transaction::ptr tx)
+template <class Backend>
+int BasicStore<Backend>::validate(tx_ptr tx)
 {
     // std::cout << "Store::validate(tid=" << tx->getId() << ")\n";
 
@@ -562,7 +2327,12 @@ int Store::validate(Transaction::ptr tx)
     // Therefore, we do not have to validate for read-onlys.
     if (tx->getChangeSet().empty())
         return OK;
+    return validateReads(tx);
+}
 
+template <class Backend>
+int BasicStore<Backend>::validateReads(tx_ptr tx)
+{
     const auto tid = tx->getId();
 
     // std::stringstream ss;
@@ -574,10 +2344,14 @@ int Store::validate(Transaction::ptr tx)
         // std::cout << ", end=" << v->end;
         // std::cout << ", data=" << v->data.to_std_string() << "\n";
 
+        // Transactions leave the table only after replacing their id
         auto vEnd = v->end.load();
+        tx_ptr other_tx;
+        while (isTransactionId(vEnd) && vEnd != tid && !tx_tab.find(vEnd, other_tx))
+            vEnd = v->end.load();
         if (isTransactionId(vEnd)) {
             // if (getTransactionStatus(vEnd) == Transaction::COMMITTED) {
-            if (vEnd != tid && getTransactionStatus(vEnd) != Transaction::FAILED) {
+            if (vEnd != tid && other_tx->getStatus().load() != Transaction::FAILED) {
                 // Version is currently tagged by transaction that has already
                 // committed. Therefore, this version is implicitly invalid
                 // which causes a read-write conflict.
@@ -616,89 +2390,206 @@ int Store::validate(Transaction::ptr tx)
     return OK;
 }
 
-int Store::persist(Transaction::ptr tx)
+template <class Backend>
+int BasicStore<Backend>::persist(tx_ptr tx, commit_slot* slot, const std::uint64_t prepared)
 {
     // std::cout << "Store::persist(tid=" << tx->getId() << "):" << '\n';
 
+    // The new versions are created and listed in the slot by a persistent
+    // transaction of their own before any of them is published. Chains are
+    // shared with concurrent commits, so publishing is never rolled back
+    // (see VersionChain::install) and nothing is allocated afterwards.
+    // Should the store go down in between, recovery frees the versions that
+    // did not make it into their chains (see recoverCommits).
     int status = OK;
     const auto tid = tx->getId();
-    pmdk::transaction::exec_tx(pop, [&,this](){
-        for (auto& [key, change] : tx->getChangeSet()) {
-            // Do nothing for removals
-            if (change.code == Transaction::Mod::Kind::Remove)
-                continue;
-
-            // Create new version
-            auto new_version = pmdk::make_persistent<Version>();
-            new_version->begin = tid;
-            new_version->data = change.delta;
-            new_version->end = TS_INFINITY;
-
-            // Register new version with change set
-            change.v_new = new_version;
-
-            // Get history of version (create if needed)
-            History::ptr history;
-            if (change.code == Transaction::Mod::Kind::Update) {
-                index_mutex.lock();
-                index->get(key, history);
-                index_mutex.unlock();
-            }
-            else if (change.code == Transaction::Mod::Kind::Insert) {
-
-                History::ptr exist_hist;
-
-                // Handle ww-conflict when installing insertions. If another
-                // transaction managed to insert a history for the same key
-                // before us, then we clearly have a write/write conflict in
-                // which case we must rollback all our installed versions and
-                // histories
-                index_mutex.lock();
-                if (index->get(key, exist_hist)) {
-                    exist_hist->mutex.lock();
-                    auto hasValidEntries = hasValidSnapshots(exist_hist);
-                    exist_hist->mutex.unlock();
-                    if (!hasValidEntries) {
-                        history = exist_hist;
+    auto& changes = tx->getChangeSet();
+
+    // History of each change and the version expected to be the newest one
+    // there (inserts only), in the order of the change set
+    std::vector<std::pair<history_ptr, version_ptr>> targets;
+    targets.reserve(changes.size());
+    const bool hasInserts = std::any_of(changes.begin(), changes.end(),
+            [](const auto& entry){
+        return entry.second.code == Transaction::Mod::Kind::Insert;
+    });
+    try {
+        // Handle ww-conflicts of insertions. If another transaction managed
+        // to insert a history for the same key before us that holds versions
+        // someone may see, then we clearly have a write/write conflict.
+        //
+        // The newest version is remembered before the history is checked.
+        // If another version is installed in between, the check is outdated
+        // and publishing ours will fail (see below).
+        //
+        // Histories for new keys are created by a transaction of their own
+        // which ends before the index is unlocked, so no one finds them
+        // unless they are durable.
+        {
+            std::lock_guard<std::mutex> guard{index_mutex};
+            for (const auto& [key, change] : changes) {
+                history_ptr history;
+                version_ptr expected;
+                if (change.code == Transaction::Mod::Kind::Insert) {
+                    if (index->get(key, history)) {
+                        recoverHistory(history);
+                        expected = history->chain.front();
+                        if (hasValidSnapshots(history)) {
+                            // std::cout << "persist(): write/write conflict!\n";
+                            return WW_CONFLICT;
+                        }
                     }
-                    else {
-                        // std::cout << "persist(): write/write conflict!\n";
-                        status = WW_CONFLICT;
+                }
+                else if (change.code == Transaction::Mod::Kind::Update) {
+                    index->get(key, history);
+                }
+                targets.emplace_back(history, expected);
+            }
+            if (hasInserts) {
+                Backend::exec_tx(pop, [&,this](){
+                    size_type i = 0;
+                    for (const auto& [key, change] : changes) {
+                        auto& history = targets[i++].first;
+                        if (change.code == Transaction::Mod::Kind::Insert && !history) {
+                            history = Backend::template make_in<LineAllocClass, History>(pop, epoch);
+                            index->put(key, history, pop);
+                        }
                     }
+                });
+            }
+        }
+
+        Backend::exec_tx(pop, [&,this](){
+            for (auto& [key, change] : changes) {
+                // Do nothing for removals
+                if (change.code == Transaction::Mod::Kind::Remove)
+                    continue;
+
+                // Create new version and register it with change set
+                auto new_version = Backend::template make_in<VersionAllocClass, Version>(pop);
+                new_version->begin = tid;
+                new_version->data = change.delta;
+                new_version->end = TS_INFINITY;
+                change.v_new = new_version;
+            }
+
+            // List the versions in the slot, so that recovery can either
+            // finalize the commit or undo it
+            if (slot) {
+                slot->versions = Backend::template make_array<version_ptr>(
+                        2 * changes.size());
+                slot->histories = Backend::template make_array<history_ptr>(
+                        changes.size());
+                size_type i = 0;
+                for (const auto& [key, change] : changes) {
+                    (void)key;
+                    slot->versions[2 * i] = change.v_new;
+                    slot->versions[2 * i + 1] = change.v_origin;
+                    slot->histories[i] = targets[i].first;
+                    ++i;
                 }
-                else {
-                    history = pmdk::make_persistent<History>();
-                    bool insertSuccess = index->put(key, history, pop);
-                    if (!insertSuccess) {
-                        // std::cout << "persist(): write/write conflict!\n";
-                        pmdk::delete_persistent<History>(history);
-                        status = WW_CONFLICT;
+                slot->count = changes.size();
+                slot->prepared = prepared;
+
+                // Recovery cannot tell the keys from the versions
+                if (changeLog && isTraced(prepared)) {
+                    const auto record = encodeChanges(tx);
+                    if (!record.empty()) {
+                        slot->change = Backend::template make_array<char>(record.size());
+                        std::memcpy(slot->change.get(), record.data(), record.size());
+                        slot->changeSize = record.size();
                     }
                 }
-                index_mutex.unlock();
             }
+        });
+    }
+    catch (const pmem::transaction_alloc_error&) {
+        // PMDK rolled back all versions created above. New histories stay
+        // empty (see abort).
+        for (auto& [key, change] : changes) {
+            (void)key;
+            change.v_new = nullptr;
+        }
+        return OUT_OF_SPACE;
+    }
 
-            if (status != OK) {
-                pmdk::delete_persistent<Version>(new_version);
-                change.v_new = nullptr;
-                return;
+    // Publish the new versions. Inserts conflict with any version that was
+    // installed after their check above. The index stays locked, so a
+    // history cannot be retired in the meantime (see retireHistory), but
+    // it may have been retired before.
+    std::vector<bool> published(changes.size(), false);
+    if (hasInserts) {
+        std::lock_guard<std::mutex> guard{index_mutex};
+        size_type i = 0;
+        for (const auto& [key, change] : changes) {
+            const auto& [history, expected] = targets[i];
+            if (change.code == Transaction::Mod::Kind::Insert) {
+                history_ptr current;
+                if (!index->get(key, current) || current != history ||
+                        !history->chain.install(change.v_new, expected, pop)) {
+                    // std::cout << "persist(): write/write conflict!\n";
+                    status = WW_CONFLICT;
+                    break;
+                }
+                published[i] = true;
             }
+            ++i;
+        }
+    }
 
-            // Add new version to item history
-            history->mutex.lock();
-            history->chain.push_front(new_version, pop);
-            history->mutex.unlock();
+    // Updates own the version they replace, so anything installed
+    // concurrently is of no concern to them and they simply try again.
+    if (status == OK) {
+        size_type i = 0;
+        for (const auto& [key, change] : changes) {
+            (void)key;
+            if (change.code == Transaction::Mod::Kind::Update) {
+                const auto& history = targets[i].first;
+                version_ptr expected;
+                do {
+                    expected = history->chain.front();
+                } while (!history->chain.install(change.v_new, expected, pop));
+                published[i] = true;
+            }
+            ++i;
         }
-    });
-    return status;
+    }
+
+    if (status != OK) {
+        // Versions that were published are rolled back in place like those
+        // of any failed transaction (see rollback). The others are freed.
+        Backend::exec_tx(pop, [&,this](){
+            size_type i = 0;
+            for (auto& [key, change] : changes) {
+                (void)key;
+                if (change.v_new && !published[i]) {
+                    Backend::template destroy<Version>(change.v_new);
+                    change.v_new = nullptr;
+                }
+                ++i;
+            }
+            if (slot)
+                clearSlot(*slot);
+        });
+        return status;
+    }
+
+    // The chains are durable, so the commit is durable once the slot
+    // carries its end timestamp
+    if (slot && isTraced(prepared)) {
+        slot->end = tx->getEnd();
+        Backend::persist(pop, &slot->end, sizeof(slot->end));
+    }
+    return OK;
 }
 
-void Store::finalize(Transaction::ptr tx)
+template <class Backend>
+void BasicStore<Backend>::finalize(tx_ptr tx)
 {
     // std::cout << "Store::finalize(tid=" << tx->getId() << "):" << '\n';
 
     const auto tx_end_stamp = tx->getEnd();
-    pmdk::transaction::exec_tx(pop, [&,this](){
+    Backend::exec_tx(pop, [&,this](){
         // Finalize timestamps on all old and new versions
         for (auto& [key, change] : tx->getChangeSet()) {
             // Suppress unused variable warning
@@ -710,6 +2601,14 @@ void Store::finalize(Transaction::ptr tx)
             // marked as such, as are new versions. Therefore, these changes
             // are neutral and all other transactions will always see valid
             // data (timestamps or TIDs).
+            //
+            // The timestamps are logged, so that they are written back when
+            // the persistent transaction ends.
+            if (change.v_new)
+                Backend::snapshot(&change.v_new->begin, sizeof(stamp_type));
+            if (change.v_origin)
+                Backend::snapshot(&change.v_origin->end, sizeof(stamp_type));
+
             switch (change.code) {
             case Transaction::Mod::Kind::Insert:
                 change.v_new->begin = tx_end_stamp;
@@ -737,12 +2636,13 @@ void Store::finalize(Transaction::ptr tx)
     });
 }
 
-void Store::rollback(Transaction::ptr tx)
+template <class Backend>
+void BasicStore<Backend>::rollback(tx_ptr tx)
 {
     // std::cout << "Store::rollback(tx{id=" << tx->getId() << "}):" << '\n';
 
     auto tid = tx->getId();
-    pmdk::transaction::exec_tx(pop, [&,this](){
+    Backend::exec_tx(pop, [&,this](){
         // Revalidate updated or removed versions and _invalidate_ new versions.
         // There may not be an new version for every insert/update if it was
         // version installment that led to this rollback.
@@ -807,30 +2707,127 @@ void Store::rollback(Transaction::ptr tx)
     });
 } // end function rollback
 
-bool Store::isValidTransaction(const Transaction::ptr tx)
+template <class Backend>
+stamp_type BasicStore<Backend>::nextStamp()
+{
+    const auto stamp = timestampCounter.fetch_add(TS_DELTA);
+    if (stamp >= stampLimit.load())
+        reserveStamps(stamp);
+    return stamp;
+}
+
+template <class Backend>
+void BasicStore<Backend>::reserveStamps(const stamp_type stamp)
+{
+    // Timestamps must not be used before they are covered by the persistent
+    // limit. Otherwise, the next session could hand them out once more.
+    // Callers that exceed the limit wait here while the first of them
+    // raises it by a large amount, so this happens rarely.
+    stamp_mutex.lock();
+    if (stamp >= stampLimit.load()) {
+        const auto limit = stamp + TS_RESERVE;
+        auto root = pop.get_root();
+        Backend::exec_tx(pop, [&](){
+            root->stampLimit.get_rw() = limit;
+        });
+        stampLimit.store(limit);
+    }
+    stamp_mutex.unlock();
+}
+
+template <class Backend>
+bool BasicStore<Backend>::hasHeadroom(tx_ptr tx)
+{
+    if (config.minHeadroom <= 0 || capacity == 0)
+        return true;
+
+    // Estimate what persist() is going to allocate. Removals allocate nothing.
+    size_type required = 0;
+    for (const auto& [key, change] : tx->getChangeSet()) {
+        if (change.code == Transaction::Mod::Kind::Remove)
+            continue;
+        required += sizeof(Version) + change.delta.size();
+        if (change.code == Transaction::Mod::Kind::Insert)
+            required += sizeof(History) + key.size();
+    }
+
+    const auto report = space();
+    const auto reserved = static_cast<size_type>(config.minHeadroom * capacity);
+    return report.allocated + required + reserved <= capacity;
+}
+
+template <class Backend>
+bool BasicStore<Backend>::isValidTransaction(const tx_ptr tx)
 {
     return (tx && tx_tab.contains(tx->getId()) &&
             tx->getStatus().load() == Transaction::ACTIVE);
 }
 
-bool Store::hasValidSnapshots(const History::ptr& hist)
+template <class Backend>
+bool BasicStore<Backend>::tagVersion(history_ptr& history, version_ptr& v, tx_ptr tx)
+{
+    // The version was found writable, so its end field holds either
+    // infinity or the id of a failed transaction. It may have been claimed
+    // by another transaction since, so we check again and only swap in our
+    // id if the field still holds what we checked.
+    auto v_end = v->end.load();
+    if (isTransactionId(v_end)) {
+        tx_ptr other_tx;
+        tx_tab.find(v_end, other_tx);
+        if (other_tx && other_tx->getStatus().load() != Transaction::FAILED)
+            return false;
+    }
+    else if (v_end != TS_INFINITY) {
+        return false;
+    }
+
+    bool tagged = false;
+    Backend::exec_tx(pop, [&,this](){
+        tagged = v->end.compare_exchange_strong(v_end, tx->getId());
+    });
+
+    // Readers must no longer take the short path for this version because
+    // its visibility now depends on our transaction (see publishInline)
+    if (tagged)
+        clearInline(history, v);
+    return tagged;
+}
+
+template <class Backend>
+bool BasicStore<Backend>::hasValidSnapshots(const history_ptr& hist)
 {
     for (auto& v : hist->chain) {
-        auto v_end = v->end.load();
+        auto v_end = resolveStamp(v->end.load());
         if (v_end == TS_INFINITY || isTransactionId(v_end))
             return true;
     }
     return false;
 }
 
-bool Store::isTransactionId(const stamp_type data)
+template <class Backend>
+stamp_type BasicStore<Backend>::resolveStamp(const stamp_type data)
+{
+    if (!isTransactionId(data))
+        return data;
+
+    tx_ptr other_tx;
+    tx_tab.find(data, other_tx);
+    if (other_tx && other_tx->getStatus().load() == Transaction::COMMITTED)
+        return other_tx->getEnd();
+    return data;
+}
+
+template <class Backend>
+bool BasicStore<Backend>::isTransactionId(const stamp_type data)
 {
     return data & 1;
 }
 
-Transaction::status_code Store::getTransactionStatus(const id_type id)
+template <class Backend>
+typename BasicStore<Backend>::Transaction::status_code
+BasicStore<Backend>::getTransactionStatus(const id_type id)
 {
-    Transaction::ptr tx;
+    tx_ptr tx;
     tx_tab.find(id, tx);
     if (!tx)
         throw std::logic_error("no transaction for id");
@@ -838,18 +2835,113 @@ Transaction::status_code Store::getTransactionStatus(const id_type id)
     return tx->getStatus().load();
 }
 
+template class BasicStore<PersistentBackend>;
+template class BasicStore<VolatileBackend>;
+template class BasicStore<EmulatedBackend>;
+
 // ############################################################################
 // FREE FUNCTIONS
 // ############################################################################
 
-bool init(Store::pool_type& pop, std::string file, size_type pool_size)
+// ############################################################################
+// POOLSETS
+// ############################################################################
+
+namespace filesystem = std::experimental::filesystem::v1;
+
+/**
+ * Parses the size of a poolset part, e.g. "512M" or "2TiB". As in PMDK,
+ * suffixes are binary unless they end in "B" without "i" (e.g. "2TB").
+ * Returns zero if the size is malformed.
+ */
+static size_type parsePartSize(const std::string& str)
+{
+    std::size_t pos = 0;
+    size_type size = 0;
+    try {
+        size = std::stoull(str, &pos);
+    }
+    catch (const std::exception&) {
+        return 0;
+    }
+
+    const auto suffix = str.substr(pos);
+    if (suffix.empty() || suffix == "B")
+        return size;
+
+    const std::string units{"KMGTP"};
+    const auto exponent = units.find(suffix[0]);
+    if (exponent == std::string::npos)
+        return 0;
+
+    size_type base = 1024;
+    if (suffix.size() == 2 && suffix[1] == 'B')
+        base = 1000;
+    else if (suffix.size() != 1 && suffix.substr(1) != "iB")
+        return 0;
+
+    for (std::size_t i = 0; i <= exponent; ++i)
+        size *= base;
+    return size;
+}
+
+/**
+ * Reads the parts (size and path) of the primary replica from the given
+ * poolset file. Returns false if the file is no poolset.
+ */
+static bool readPoolSet(const std::string& file,
+        std::vector<std::pair<size_type, std::string>>& parts)
+{
+    std::ifstream in{file};
+    std::string line;
+    if (!std::getline(in, line) || line.compare(0, 11, "PMEMPOOLSET") != 0)
+        return false;
+
+    while (std::getline(in, line)) {
+        std::istringstream tokens{line};
+        std::string size, path;
+        if (!(tokens >> size) || size[0] == '#' || size == "OPTION")
+            continue;
+        // Replicas mirror the primary one, so they add no space
+        if (size == "REPLICA")
+            break;
+        if (tokens >> path)
+            parts.emplace_back(parsePartSize(size), path);
+    }
+    return true;
+}
+
+/**
+ * A poolset exists once PMDK has created its first part. Directory parts
+ * are created by the user and filled by PMDK.
+ */
+static bool existsPoolSet(const std::vector<std::pair<size_type, std::string>>& parts)
+{
+    if (parts.empty())
+        return false;
+
+    const filesystem::path first{parts.front().second};
+    if (filesystem::is_directory(first))
+        return !filesystem::is_empty(first);
+    return filesystem::exists(first);
+}
+
+template <class StoreType>
+static bool openPool(typename StoreType::pool_type& pop, std::string file,
+        size_type pool_size)
 {
-    namespace filesystem = std::experimental::filesystem::v1;
-    using pool_type = Store::pool_type;
-    using index_type = Store::index_type;
+    using backend_type = typename StoreType::backend_type;
+    using pool_type = typename StoreType::pool_type;
+    using index_type = typename StoreType::index_type;
+
+    // The size of a poolset is given by its parts
+    std::vector<std::pair<size_type, std::string>> parts;
+    const auto isPoolSet = readPoolSet(file, parts);
+    if (isPoolSet)
+        pool_size = 0;
 
     const std::string layout{"midas"};
-    if (filesystem::exists(file)) {
+    if (isPoolSet ? existsPoolSet(parts) : filesystem::exists(file)) {
         if (pool_type::check(file, layout) != 1) {
             std::cout << "File seems to be corrupt! Aborting..." << std::endl;
             return false;
@@ -859,12 +2951,36 @@ bool init(Store::pool_type& pop, std::string file, size_type pool_size)
     else {
         pop = pool_type::create(file, layout, pool_size);
         auto root = pop.get_root();
-        pmdk::transaction::exec_tx(pop, [&](){
-            root->index = pmdk::make_persistent<index_type>();
+        backend_type::exec_tx(pop, [&](){
+            root->index = backend_type::template make<index_type>();
         });
     }
+
+    // Parts may have been added to a poolset since the last session
+    size_type capacity = 0;
+    if (isPoolSet) {
+        for (const auto& part : parts)
+            capacity += part.first;
+    }
+    else {
+        capacity = filesystem::file_size(file);
+    }
+    auto root = pop.get_root();
+    backend_type::exec_tx(pop, [&](){
+        root->capacity = capacity;
+    });
     return true;
 }
 
+bool init(Store::pool_type& pop, std::string file, size_type pool_size)
+{
+    return openPool<Store>(pop, file, pool_size);
+}
+
+bool init(EmulatedStore::pool_type& pop, std::string file, size_type pool_size)
+{
+    return openPool<EmulatedStore>(pop, file, pool_size);
+}
+
 } // end namespace detail
 } // end namespace midas
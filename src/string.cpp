@@ -3,16 +3,21 @@
 namespace midas {
 namespace detail {
 
-std::ostream& operator<<(std::ostream& os, const NVString& str)
+template <class Backend>
+std::ostream& operator<<(std::ostream& os, const BasicNVString<Backend>& str)
 {
     const auto size = str.size.get_ro();
     os << "persistent_string [size=" << size;
     os << ", data={";
-    for (NVString::size_type i=0; i<size; ++i)
+    for (typename BasicNVString<Backend>::size_type i=0; i<size; ++i)
         os << str.data[i];
     os << "}]";
     return os;
 }
 
+template std::ostream& operator<<(std::ostream&, const BasicNVString<PersistentBackend>&);
+template std::ostream& operator<<(std::ostream&, const BasicNVString<VolatileBackend>&);
+template std::ostream& operator<<(std::ostream&, const BasicNVString<EmulatedBackend>&);
+
 } // end namespace detail
 } // end namespace midas
@@ -93,6 +93,7 @@ struct my_hashmap_config {
     static constexpr size_type INIT_SIZE = 4;
     static constexpr size_type GROW_FACTOR = 2;
     static constexpr float_type MAX_LOAD_FACTOR = 0.75;
+    static constexpr float_type MIN_LOAD_FACTOR = 0.25;
 };
 
 // ############################################################################
@@ -145,6 +146,8 @@ void usage()
     std::cout << "        Removes all pairs with the given value\n";
     std::cout << "    clear\n";
     std::cout << "        Removes all key-value pairs in this map. Number of buckets remains equal\n";
+    std::cout << "    shrink\n";
+    std::cout << "        Reduces the number of buckets to the smallest size that fits all pairs\n";
     std::cout << std::endl;
 }
 
@@ -239,6 +242,9 @@ void launch(pool_t& pool, const std::string& cmd, const std::string& arg1,
     else if (cmd == "clear") {
         map->clear(pool);
     }
+    else if (cmd == "shrink") {
+        map->shrink_to_fit(pool);
+    }
     else {
         std::cout << "error: invalid arguments" << std::endl;
         usage();